@@ -21,9 +21,12 @@
 #include <algorithm>
 #include <cassert>
 #include <filesystem>
+#include <fstream>
 #include <deque>
+#include <iomanip>
 #include <iosfwd>
 #include <memory>
+#include <numeric>
 #include <ostream>
 #include <sstream>
 #include <string_view>
@@ -33,6 +36,7 @@
 #include "evaluate.h"
 #include "misc.h"
 #include "nnue/network.h"
+#include "nnue/nnue_accumulator.h"
 #include "nnue/nnue_common.h"
 #include "numa.h"
 #include "perft.h"
@@ -89,10 +93,57 @@ Engine::Engine(std::optional<std::filesystem::path> path) :
 
     options.add(  //
       "Hash", Option(16, 1, MaxHashMB, [this](const Option& o) {
+          const usize oldMB = tt.size_mb();
           set_tt_size(o);
+
+          // The entries are kept on resize, unless the table grows too much
+          if (oldMB && !tt.is_shared() && usize(o) > TranspositionTable::MaxRehashGrowth * oldMB)
+              return "Hash grown more than " + std::to_string(TranspositionTable::MaxRehashGrowth)
+                   + " times, the previous entries were not kept";
+
+          return tt_sharing_information_as_string();
+      }));
+
+    options.add(  //
+      "HashNumaPolicy", Option("auto var auto var interleave var local var none", "auto",
+                               [this](const Option&) {
+                                   set_tt_size(options["Hash"]);
+                                   return tt_placement_information_as_string();
+                               }));
+
+    options.add(  //
+      "SharedHash", Option("", [this](const Option&) {
+          set_tt_size(options["Hash"]);
+          return tt_sharing_information_as_string();
+      }));
+
+    options.add(  //
+      "ColdHash", Option(0, 0, MaxHashMB, [this](const Option& o) {
+          wait_for_search_finished();
+          tt.resize_cold_tier(o, threads);
           return std::nullopt;
       }));
 
+    options.add(  //
+      "EvalCache", Option(0, 0, 256, [this](const Option& o) {
+          wait_for_search_finished();
+          threads.resize_eval_cache(o);
+          return "Eval cache: " + std::to_string(int(o)) + " MiB per thread";
+      }));
+
+    options.add(  //
+      "AccumulatorStore", Option(0, 0, 1024, [this](const Option& o) {
+          wait_for_search_finished();
+          threads.resize_accumulator_store(o);
+          return "Accumulator store: " + std::to_string(int(o)) + " MiB per thread";
+      }));
+
+    options.add(  //
+      "SoftClear", Option(false));
+
+    options.add(  //
+      "CooperativeSearch", Option(false));
+
     options.add(  //
       "Clear Hash", Option([this](const Option&) {
           search_clear();
@@ -105,6 +156,9 @@ Engine::Engine(std::optional<std::filesystem::path> path) :
     options.add(  //
       "MultiPV", Option(1, 1, MAX_MOVES));
 
+    options.add(  //
+      "ParallelMultiPV", Option(false));
+
     options.add("Skill Level", Option(20, 0, 20));
 
     options.add("Move Overhead", Option(10, 0, 5000));
@@ -163,8 +217,16 @@ void Engine::stop() { threads.stop = true; }
 void Engine::search_clear() {
     wait_for_search_finished();
 
-    tt.clear(threads);
-    threads.clear();
+    // A soft clear returns at once. The hash is invalidated in constant time, and
+    // the threads reset their histories in the background before their next job.
+    // A table which cannot be soft cleared, e.g. a shared one, is cleared as usual.
+    if (options["SoftClear"] && tt.soft_clear())
+        threads.clear(true);
+    else
+    {
+        tt.clear(threads);
+        threads.clear();
+    }
 
     // TODO: does not work with multiple instances
     Tablebases::init(options["SyzygyPath"]);  // Free mapped files
@@ -190,7 +252,12 @@ void Engine::set_on_verify_network(std::function<void(std::string_view)>&& f) {
     onVerifyNetwork = std::move(f);
 }
 
-void Engine::wait_for_search_finished() { threads.main_thread()->wait_for_search_finished(); }
+void Engine::wait_for_search_finished() {
+    threads.main_thread()->wait_for_search_finished();
+
+    // The other threads may still be busy with a background clear
+    threads.wait_for_search_finished();
+}
 
 std::optional<PositionSetError> Engine::set_position(const std::string&              fen,
                                                      const std::vector<std::string>& moves) {
@@ -256,7 +323,29 @@ void Engine::resize_threads() {
 
 void Engine::set_tt_size(usize mb) {
     wait_for_search_finished();
-    tt.resize(mb, threads);
+
+    // By default, the table follows the threads when they are bound to several
+    // nodes, and is otherwise left to the OS as it is probed from everywhere.
+    const Option& policy    = options["HashNumaPolicy"];
+    TTPlacement   placement = TTPlacement::FirstTouch;
+
+    if (policy == "interleave")
+        placement = TTPlacement::Interleave;
+    else if (policy == "local" || (policy == "auto" && threads.numa_nodes() > 1))
+        placement = TTPlacement::NodeLocal;
+
+    tt.resize(mb, threads, numaContext.get_numa_config(), placement,
+              std::string(options["SharedHash"]));
+}
+
+std::optional<std::string> Engine::save_tt(const std::filesystem::path& file) {
+    wait_for_search_finished();
+    return tt.save(file);
+}
+
+std::optional<std::string> Engine::load_tt(const std::filesystem::path& file) {
+    wait_for_search_finished();
+    return tt.load(file, threads);
 }
 
 void Engine::set_ponderhit(bool b) { threads.main_manager()->ponder = b; }
@@ -314,7 +403,34 @@ void Engine::load_network(const std::filesystem::path& file) {
     threads.ensure_network_replicated();
 }
 
-void Engine::save_network(const std::optional<std::filesystem::path>& file) {
+std::optional<std::string> Engine::publish_network(const std::string& file) {
+    // Load into a fresh network, so that a failure leaves the current one alone
+    auto         source = std::make_unique<NN::Network>();
+    NN::EvalFile evalFile{std::nullopt, ""};
+    const auto   path = path_from_utf8(file);
+
+    source->load(binaryDirectory, path, evalFile);
+    if (evalFile.current != path)
+        return "Failed to load the network " + file;
+
+    // Searches hold on to the replicas of the old network until their next
+    // iteration, the last of them to switch releases it.
+    network     = std::move(source);
+    networkFile = evalFile;
+
+    // Set the option without its callback, which would load the file again
+    options.options_map["EvalFile"].currentValue = file;
+    return std::nullopt;
+}
+
+void Engine::save_network(const std::optional<std::filesystem::path>& file, bool native) {
+    if (native)
+    {
+        assert(file.has_value());
+        network->save_native(networkFile, *file);
+        return;
+    }
+
     network.modify_and_replicate(
       [&file, this](NN::Network& network_) { network_.save(networkFile, file); });
 }
@@ -331,6 +447,118 @@ void Engine::trace_eval() const {
     sync_cout << "\n" << Eval::trace(p, *network) << sync_endl;
 }
 
+std::string Engine::nnue_bench(int rounds) const {
+    verify_network();
+
+    return Eval::NNUE::stage_benchmark(*network, rounds);
+}
+
+std::optional<std::string>
+Engine::reorder_network(const std::filesystem::path&                file,
+                        const std::optional<std::filesystem::path>& fenFile) {
+    std::vector<std::string> fens;
+
+    if (fenFile)
+    {
+        std::ifstream in(*fenFile);
+        if (!in)
+            return "Failed to open " + fenFile->string();
+
+        for (std::string line; std::getline(in, line);)
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                fens.push_back(line);
+    }
+    else
+        fens = NN::corpus_positions(32);
+
+    verify_network();
+
+    // The loaded network may be shared between processes, so reorder a copy
+    auto        reordered = std::make_unique<NN::Network>(*network);
+    std::string report;
+
+    if (const auto err = NN::reorder_neurons(*reordered, fens, options["UCI_Chess960"], report))
+        return err;
+
+    sync_cout << report << sync_endl;
+
+    reordered->save(networkFile, file);
+    return std::nullopt;
+}
+
+std::optional<std::string> Engine::eval_batch(const std::filesystem::path& file) const {
+    std::ifstream in(file);
+    if (!in)
+        return "Failed to open " + file.string();
+
+    verify_network();
+
+    // Positions are read and evaluated in chunks, so arbitrarily large files can
+    // be scored with bounded memory.
+    constexpr usize ChunkSize = 4096;
+
+    auto accumulators = std::make_unique<Eval::NNUE::AccumulatorStack>();
+    auto caches       = std::make_unique<Eval::NNUE::AccumulatorCaches>(*network);
+    auto positions    = std::make_unique<Position[]>(ChunkSize);
+    auto stateInfos   = std::make_unique<StateInfo[]>(ChunkSize);
+
+    std::vector<const Position*>   batch;
+    std::vector<NN::NetworkOutput> outputs(ChunkSize);
+    const bool                     chess960  = options["UCI_Chess960"];
+    usize                          evaluated = 0, skipped = 0;
+    const TimePoint                start     = now();
+    std::string                    line;
+
+    const auto flush = [&]() {
+        network->evaluate_batch(batch.data(), batch.size(), *accumulators, *caches,
+                                outputs.data());
+
+        std::ostringstream ss;
+        for (usize i = 0; i < batch.size(); ++i)
+        {
+            const Position& p             = *batch[i];
+            const auto [psqt, positional] = outputs[i];
+            const Value     v             = psqt + positional;
+
+            ss << (i ? "\n" : "") << p.fen() << " ; "
+               << UCIEngine::to_cp(p.side_to_move() == WHITE ? v : -v, p);
+        }
+
+        sync_cout << ss.str() << sync_endl;
+        evaluated += batch.size();
+        batch.clear();
+    };
+
+    batch.reserve(ChunkSize);
+    while (std::getline(in, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        Position& p = positions[batch.size()];
+        if (p.set(line, chess960, &stateInfos[batch.size()]))
+        {
+            ++skipped;
+            continue;
+        }
+
+        batch.push_back(&p);
+        if (batch.size() == ChunkSize)
+            flush();
+    }
+
+    if (!batch.empty())
+        flush();
+
+    const TimePoint elapsed = now() - start + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    sync_cout << "info string Evaluated " << evaluated << " positions (" << skipped
+              << " skipped) in " << elapsed << " ms, " << evaluated * 1000 / elapsed
+              << " positions/s" << sync_endl;
+
+    return std::nullopt;
+}
+
 const OptionsMap& Engine::get_options() const { return options; }
 OptionsMap&       Engine::get_options() { return options; }
 
@@ -344,8 +572,93 @@ std::string Engine::visualize() const {
     return ss.str();
 }
 
+// Reports the distribution of the entries of the table, the probe counters of the
+// last search and the paths its accumulator updates took. The table is scanned
+// in full, or sampled if sampleClusters > 0.
+std::string Engine::tt_stats(usize sampleClusters) {
+    wait_for_search_finished();
+
+    const TTStats s = tt.stats(threads, sampleClusters);
+
+    std::stringstream ss;
+
+    auto permille = [](u64 n, u64 total) { return 1000 * n / std::max<u64>(total, 1); };
+    auto line     = [&](const std::string& label, u64 n) {
+        ss << "\n  " << std::left << std::setw(14) << label << std::right << std::setw(12) << n
+           << std::setw(6) << permille(n, s.occupied);
+    };
+
+    ss << (sampleClusters ? "Sampled " : "Scanned ") << s.clusters << " clusters, "
+       << s.occupied << " of " << s.entries << " entries occupied ("
+       << permille(s.occupied, s.entries) << " per mille)"
+       << "\nEntries by depth, count and per mille of the occupied entries:";
+
+    // Depths are grouped by 4 plies, the internal depth is offset by DEPTH_NONE
+    for (usize i = 0; i < s.depth.size(); i += 4)
+    {
+        u64 n = 0;
+        for (usize j = i; j < i + 4; ++j)
+            n += s.depth[j];
+
+        if (n)
+            line(std::to_string(int(i) + DEPTH_NONE) + ".." + std::to_string(int(i) + DEPTH_NONE + 3),
+                 n);
+    }
+
+    ss << "\nEntries by age in searches:";
+    for (usize i = 0; i < s.age.size(); ++i)
+        if (s.age[i])
+            line(std::to_string(i), s.age[i]);
+
+    ss << "\nEntries by bound:";
+    line("none", s.bound[BOUND_NONE]);
+    line("upper", s.bound[BOUND_UPPER]);
+    line("lower", s.bound[BOUND_LOWER]);
+    line("exact", s.bound[BOUND_EXACT]);
+    line("pv", s.pv);
+
+#ifndef NO_TT_STATS
+    const u64 probes = threads.tt_probes();
+    ss << "\nLast search:"
+       << "\n  probes        " << probes
+       << "\n  hits          " << threads.tt_hits() << " (" << permille(threads.tt_hits(), probes)
+       << " per mille)"
+       << "\n  evictions     " << threads.tt_evictions() << " ("
+       << permille(threads.tt_evictions(), probes) << " per mille)"
+       << "\n  eval probes   " << threads.eval_cache_probes()
+       << "\n  eval hits     " << threads.eval_cache_hits() << " ("
+       << permille(threads.eval_cache_hits(), threads.eval_cache_probes()) << " per mille)";
+#else
+    ss << "\nLast search: probe counters compiled out";
+#endif
+
+    // Accumulator updates are counted per perspective
+    const auto paths   = threads.accumulator_update_paths();
+    const u64  updates = std::accumulate(paths.begin(), paths.end(), u64(0));
+
+    ss << "\nAccumulator updates in the last search, count and per mille:";
+    for (auto [label, path] : {std::pair{"incremental", Eval::NNUE::UPDATE_INCREMENTAL},
+                               std::pair{"replay", Eval::NNUE::UPDATE_REPLAY},
+                               std::pair{"refresh", Eval::NNUE::UPDATE_REFRESH},
+                               std::pair{"store", Eval::NNUE::UPDATE_STORE}})
+        ss << "\n  " << std::left << std::setw(14) << label << std::right << std::setw(12)
+           << paths[path] << std::setw(6) << permille(paths[path], updates);
+
+    return ss.str();
+}
+
 int Engine::get_hashfull(int maxAge) const { return tt.hashfull(maxAge); }
 
+u64 Engine::get_tt_probes() const { return threads.tt_probes(); }
+
+u64 Engine::get_tt_hits() const { return threads.tt_hits(); }
+
+u64 Engine::get_tt_evictions() const { return threads.tt_evictions(); }
+
+u64 Engine::get_eval_cache_probes() const { return threads.eval_cache_probes(); }
+
+u64 Engine::get_eval_cache_hits() const { return threads.eval_cache_hits(); }
+
 std::vector<std::pair<usize, usize>> Engine::get_bound_thread_count_by_numa_node() const {
     auto                                 counts = threads.get_bound_thread_count_by_numa_node();
     const NumaConfig&                    cfg    = numaContext.get_numa_config();
@@ -368,6 +681,44 @@ std::string Engine::numa_config_information_as_string() const {
     return "Available processors: " + cfgStr;
 }
 
+std::string Engine::tt_placement_information_as_string() const {
+    const auto pagesPerNode = tt.numa_placement();
+
+    // Nothing worth reporting unless the table spans several nodes
+    usize nodes = 0, total = 0;
+    for (auto&& [node, pages] : pagesPerNode)
+    {
+        nodes += node >= 0;
+        total += pages;
+    }
+
+    if (nodes <= 1)
+        return "";
+
+    std::stringstream ss;
+    ss << "Hash pages per NUMA node:";
+
+    for (auto&& [node, pages] : pagesPerNode)
+        ss << " " << (node >= 0 ? std::to_string(node) : "untouched") << ":"
+           << pages * 100 / total << "%";
+
+    return ss.str();
+}
+
+std::string Engine::tt_sharing_information_as_string() const {
+    const std::string name(options["SharedHash"]);
+
+    if (name.empty())
+        return "";
+
+    return tt.is_shared() ? "Hash shared as '" + name + "'"
+                          : "Failed to share the hash as '" + name + "', using private memory";
+}
+
+std::string Engine::tt_geometry_information_as_string() const {
+    return TranspositionTable::cluster_geometry();
+}
+
 std::string Engine::thread_binding_information_as_string() const {
     auto              boundThreadsByNode = get_bound_thread_count_by_numa_node();
     std::stringstream ss;
@@ -78,6 +78,9 @@ class Engine {
     bool set_numa_config_from_option(const std::string& o);
     void resize_threads();
     void set_tt_size(usize mb);
+    // save or restore the transposition table, returns an error message on failure
+    std::optional<std::string> save_tt(const std::filesystem::path& file);
+    std::optional<std::string> load_tt(const std::filesystem::path& file);
     void set_ponderhit(bool);
     void search_clear();
 
@@ -92,25 +95,46 @@ class Engine {
     void                                 verify_network() const;
     std::unique_ptr<Eval::NNUE::Network> get_default_network();
     void                                 load_network(const std::filesystem::path& file);
-    void save_network(const std::optional<std::filesystem::path>& file);
+    void save_network(const std::optional<std::filesystem::path>& file, bool native = false);
+    // loads a network while searches may be running, they switch to it at their next
+    // iteration, and makes it the EvalFile
+    std::optional<std::string> publish_network(const std::string& file);
 
     // utility functions
 
     void trace_eval() const;
+    // reads one FEN per line and prints its NNUE evaluation, evaluated in batches
+    std::optional<std::string> eval_batch(const std::filesystem::path& file) const;
+    std::string                nnue_bench(int rounds) const;
+    // writes the network with its L1 neurons ordered for sparser fc_0 input, sampling
+    // the positions of the given file or, without one, the nnuebench games
+    std::optional<std::string> reorder_network(const std::filesystem::path&                file,
+                                               const std::optional<std::filesystem::path>& fens);
 
     const OptionsMap& get_options() const;
     OptionsMap&       get_options();
 
     int get_hashfull(int maxAge = 0) const;
 
+    // Transposition table probes, hits and evictions of the last search
+    u64 get_tt_probes() const;
+    u64 get_tt_hits() const;
+    u64 get_tt_evictions() const;
+    u64 get_eval_cache_probes() const;
+    u64 get_eval_cache_hits() const;
+
     std::string                          fen() const;
     std::optional<PositionSetError>      flip();
     std::string                          visualize() const;
+    std::string                          tt_stats(usize sampleClusters);
     std::vector<std::pair<usize, usize>> get_bound_thread_count_by_numa_node() const;
     std::string                          get_numa_config_as_string() const;
     std::string                          numa_config_information_as_string() const;
     std::string                          thread_allocation_information_as_string() const;
     std::string                          thread_binding_information_as_string() const;
+    std::string                          tt_placement_information_as_string() const;
+    std::string                          tt_sharing_information_as_string() const;
+    std::string                          tt_geometry_information_as_string() const;
 
    private:
     const std::filesystem::path binaryDirectory;
@@ -45,10 +45,17 @@ Value Eval::evaluate(const Eval::NNUE::Network&     network,
                      Eval::NNUE::AccumulatorCaches& caches,
                      int                            optimism) {
 
-    assert(!pos.checkers());
-
     auto [psqt, positional] = network.evaluate(pos, accumulators, caches);
 
+    return evaluate(psqt, positional, pos, optimism);
+}
+
+// Blends the raw output of the network, psqt and positional, into the final
+// evaluation. Split out for callers that already know the network output.
+Value Eval::evaluate(Value psqt, Value positional, const Position& pos, int optimism) {
+
+    assert(!pos.checkers());
+
     Value nnue = psqt + positional;
 
     // Blend optimism and eval with nnue complexity
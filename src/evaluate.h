@@ -48,6 +48,8 @@ Value evaluate(const NNUE::Network&           network,
                Eval::NNUE::AccumulatorStack&  accumulators,
                Eval::NNUE::AccumulatorCaches& caches,
                int                            optimism);
+
+Value evaluate(Value psqt, Value positional, const Position& pos, int optimism);
 }  // namespace Eval
 
 }  // namespace Stockfish
@@ -27,11 +27,27 @@
 
 #if defined(__linux__) && !defined(__ANDROID__)
     #include <errno.h>
+    #include <linux/mempolicy.h>
     #include <sys/mman.h>
+    #include <sys/syscall.h>
     // IWYU pragma: no_include <bits/mman-map-flags-generic.h>
     #include <cstring>
     #include <mutex>
     #include <map>
+    #include <unistd.h>
+
+    #if defined(SYS_mbind) && defined(SYS_move_pages)
+        #define HAS_NUMA_PLACEMENT
+    #endif
+#endif
+
+#if defined(__linux__) || defined(__APPLE__)
+    #define HAS_FILE_MAPPING
+    #include <cerrno>
+    #include <cstring>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
 #endif
 
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) \
@@ -251,4 +267,97 @@ void aligned_large_pages_free(void* mem) {
 }
 
 #endif
+
+
+// set_numa_placement() and sample_numa_placement() use the raw system calls, so
+// that we do not depend on libnuma being installed.
+
+bool set_numa_placement([[maybe_unused]] void*                  mem,
+                        [[maybe_unused]] usize                  size,
+                        [[maybe_unused]] const std::set<usize>& systemNodes,
+                        [[maybe_unused]] bool                   interleave) {
+#ifdef HAS_NUMA_PLACEMENT
+    if (!mem || systemNodes.empty())
+        return false;
+
+    constexpr usize            BitsPerWord = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> nodeMask(*systemNodes.rbegin() / BitsPerWord + 1, 0);
+
+    for (usize n : systemNodes)
+        nodeMask[n / BitsPerWord] |= 1UL << (n % BitsPerWord);
+
+    // The kernel ignores the last bit of maxnode, hence the + 1
+    return syscall(SYS_mbind, mem, size, interleave ? MPOL_INTERLEAVE : MPOL_BIND, nodeMask.data(),
+                   nodeMask.size() * BitsPerWord + 1, MPOL_MF_MOVE)
+        == 0;
+#else
+    return false;
+#endif
+}
+
+std::vector<int> sample_numa_placement([[maybe_unused]] const void* mem,
+                                       [[maybe_unused]] usize       size,
+                                       [[maybe_unused]] usize       samples) {
+#ifdef HAS_NUMA_PLACEMENT
+    if (!mem || !samples)
+        return {};
+
+    const usize pageSize = usize(sysconf(_SC_PAGESIZE));
+
+    std::vector<void*> pages(samples);
+    std::vector<int>   status(samples, -1);
+
+    for (usize i = 0; i < samples; ++i)
+    {
+        const usize addr = reinterpret_cast<usize>(mem) + size / samples * i;
+        pages[i]         = reinterpret_cast<void*>(addr / pageSize * pageSize);
+    }
+
+    // With a null node list, move_pages() only queries where the pages are
+    if (syscall(SYS_move_pages, 0, samples, pages.data(), nullptr, status.data(), 0) != 0)
+        return {};
+
+    for (int& s : status)
+        s = std::max(s, -1);
+
+    return status;
+#else
+    return {};
+#endif
+}
+
+
+// map_file_private() maps a region of a file with copy-on-write semantics, so
+// that pages are only read from disk when first touched. Memory returned by it
+// must be released with unmap_file().
+
+void* map_file_private([[maybe_unused]] const std::filesystem::path& file,
+                       [[maybe_unused]] usize                        offset,
+                       [[maybe_unused]] usize                        size) {
+#ifdef HAS_FILE_MAPPING
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, off_t(offset));
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    return mem == MAP_FAILED ? nullptr : mem;
+#else
+    return nullptr;
+#endif
+}
+
+void unmap_file([[maybe_unused]] void* mem, [[maybe_unused]] usize size) {
+#ifdef HAS_FILE_MAPPING
+    if (mem && munmap(mem, size) != 0)
+    {
+        std::cerr << "munmap failed: " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+#endif
+}
+
 }  // namespace Stockfish
@@ -24,9 +24,12 @@
 #include <cstdint>
 #include <memory>
 #include <new>
+#include <set>
 #include <type_traits>
 #include <utility>
 #include <cstring>
+#include <filesystem>
+#include <vector>
 
 #include "types.h"
 #include "misc.h"
@@ -75,6 +78,21 @@ void  aligned_large_pages_free(void* mem);
 
 bool has_large_pages();
 
+// Sets the NUMA placement of a page aligned range of memory to the given system
+// NUMA nodes, either interleaved across them or bound to them, and migrates pages
+// which are already present. Returns false if unsupported or the policy failed.
+bool set_numa_placement(void* mem, usize size, const std::set<usize>& systemNodes, bool interleave);
+
+// Returns the system NUMA node of `samples` pages spread evenly over the range, or
+// an empty vector if unsupported. Pages which were never touched are reported as -1.
+std::vector<int> sample_numa_placement(const void* mem, usize size, usize samples);
+
+// Maps part of a file as private, copy-on-write memory. Writes to the mapping are
+// never carried through to the file. Returns nullptr if the platform does not
+// support file mappings or the mapping failed. The offset must be page aligned.
+void* map_file_private(const std::filesystem::path& file, usize offset, usize size);
+void  unmap_file(void* mem, usize size);
+
 // Frees memory which was placed there with placement new.
 // Works for both single objects and arrays of unknown bound.
 template<typename T, typename FREE_FUNC>
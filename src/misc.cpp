@@ -289,6 +289,9 @@ std::string compiler_info() {
     compiler += " LSX";
 #endif
     compiler += (HasPopCnt ? " POPCNT" : "");
+#if defined(NNUE_THREAT_INT4)
+    compiler += " INT4_THREATS";
+#endif
 
 #if !defined(NDEBUG)
     compiler += " DEBUG";
@@ -452,13 +455,96 @@ std::ostream& operator<<(std::ostream& os, SyncCout sc) {
 void sync_cout_start() { std::cout << IO_LOCK; }
 void sync_cout_end() { std::cout << IO_UNLOCK; }
 
+namespace {
+
+constexpr usize HashLanes           = 8;
+constexpr usize HashStripeSize      = HashLanes * sizeof(u64);
+constexpr usize HashStripesPerBlock = 16;
+constexpr usize HashBlockSize       = HashStripesPerBlock * HashStripeSize;
+
+// Every stripe of a block is keyed differently, so that the lanes depend on
+// where in the block a word is.
+constexpr auto HashKeys = [] {
+    constexpr u64 Secret[HashLanes] = {0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull,
+                                       0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+                                       0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull,
+                                       0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull};
+
+    std::array<u64, HashStripesPerBlock * HashLanes> keys{};
+    for (usize s = 0; s < HashStripesPerBlock; ++s)
+        for (usize l = 0; l < HashLanes; ++l)
+            keys[s * HashLanes + l] = Secret[l] + s * 0x9e3779b97f4a7c15ull;
+    return keys;
+}();
+
+// Folds whole blocks into the lanes in the style of XXH3. The lanes are
+// independent, so that the compiler vectorizes the loop, and are scrambled
+// after each block, so that permuted blocks (e.g. reordered neurons) do not
+// collide.
+void hash_blocks(const char* data, const char* end, u64 (&lanes)[HashLanes]) {
+    // A local copy, which the input can not alias
+    u64 acc[HashLanes];
+    std::memcpy(acc, lanes, sizeof(acc));
+
+    for (; data != end; data += HashBlockSize)
+    {
+        for (usize s = 0; s < HashStripesPerBlock; ++s)
+        {
+            u64 k[HashLanes];
+            for (usize l = 0; l < HashLanes; ++l)
+                std::memcpy(&k[l], data + s * HashStripeSize + l * sizeof(u64), sizeof(u64));
+
+            // The neighbouring word is added as is, so that no input is lost
+            // when one half of the product is zero
+            for (usize l = 0; l < HashLanes; ++l)
+            {
+                const u64 x = k[l] ^ HashKeys[s * HashLanes + l];
+                acc[l] += k[l ^ 1] + u64(u32(x)) * u64(u32(x >> 32));
+            }
+        }
+
+        for (usize l = 0; l < HashLanes; ++l)
+            acc[l] = (acc[l] ^ (acc[l] >> 47) ^ HashKeys[l]) * 0x9e3779b1u;
+    }
+
+    std::memcpy(lanes, acc, sizeof(acc));
+}
+
+}  // namespace
+
 // Hash function based on public domain MurmurHash64A, by Austin Appleby.
+// Its chain of multiplications makes hashing network weights several times
+// slower than reading them, so long inputs are first folded into independent
+// lanes by hash_blocks(), which are then mixed in like ordinary words.
 u64 hash_bytes(const char* data, usize size) {
     const u64 m = 0xc6a4a7935bd1e995ull;
     const int r = 47;
 
     u64 h = size * m;
 
+    if (size >= HashBlockSize)
+    {
+        u64 acc[HashLanes];
+        for (usize l = 0; l < HashLanes; ++l)
+            acc[l] = h ^ HashKeys[l];
+
+        const char* blocksEnd = data + size / HashBlockSize * HashBlockSize;
+        hash_blocks(data, blocksEnd, acc);
+        data = blocksEnd;
+
+        for (u64 k : acc)
+        {
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+        }
+
+        size %= HashBlockSize;
+    }
+
     const char* end = data + (size & ~(usize) 7);
 
     for (const char* p = data; p != end; p += 8)
@@ -380,4 +380,21 @@ top:
 
 void MovePicker::skip_quiet_moves() { skipQuiets = true; }
 
+// Peeks at up to count moves which next_move() is about to emit, without consuming
+// them. Only the capture stages of qsearch and ProbCut are covered, as their moves
+// are fully sorted and their subtrees are small. Moves which the stage filter will
+// reject may be included, so the result is only a hint, used for prefetching.
+int MovePicker::upcoming_moves(Move* out, int count) const {
+
+    if (stage != QCAPTURE && stage != PROBCUT)
+        return 0;
+
+    int n = 0;
+    for (const ExtMove* it = cur; it < endCur && n < count; ++it)
+        if (*it != ttMove)
+            out[n++] = *it;
+
+    return n;
+}
+
 }  // namespace Stockfish
@@ -50,6 +50,7 @@ class MovePicker {
     MovePicker(const Position&, Move, int, const CapturePieceToHistory*);
     Move next_move();
     void skip_quiet_moves();
+    int  upcoming_moves(Move* out, int count) const;
 
    private:
     template<typename Pred>
@@ -20,6 +20,7 @@
 
 #include "full_threats.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <initializer_list>
@@ -264,6 +265,95 @@ void FullThreats::append_active_indices(Color perspective, const Position& pos,
     }
 }
 
+#if defined(USE_AVX2) && defined(NNUE_THREAT_GATHER)
+
+// Computes make_index() for a batch of packed DirtyThreats at once, gathering
+// from the same lookup tables. Lanes from count on are masked off. The indices
+// are written to out and the add flags are returned as a bitmask. index_lut2
+// holds bytes, so each entry is gathered as the top byte of the word ending at
+// it, which never starts before the table as attackers are never NO_PIECE.
+// Built with threatindices=gather only, as gathers are slower than the scalar
+// lookups on CPUs with the Gather Data Sampling mitigation.
+template<int Lanes>
+inline sf_always_inline u32 make_indices(
+  Color perspective, Square ksq, const DirtyThreat* dirties, int count, IndexType* out) {
+    static_assert(sizeof(DirtyThreat) == 4 && sizeof(IndexType) == 4);
+
+    const int orientation = FullThreats::OrientTBL[ksq] ^ (56 * perspective);
+    const int swap        = 8 * perspective;
+
+    const auto* lut1 = reinterpret_cast<const int*>(index_lut1.data());
+    const auto* offs = reinterpret_cast<const int*>(offsets.data());
+    const auto* lut2 = reinterpret_cast<const int*>(index_lut2.data());
+
+    #if defined(USE_AVX512)
+    static_assert(Lanes == 16);
+
+    const __mmask16 mask = __mmask16((1u << count) - 1);
+    const __m512i   zero = _mm512_setzero_si512();
+    const __m512i   raw  = _mm512_maskz_loadu_epi32(mask, dirties);
+
+    // Orient both squares with a single xor
+    const __m512i oriented = _mm512_xor_si512(raw, _mm512_set1_epi32(orientation * 0x101));
+    const __m512i from     = _mm512_and_si512(oriented, _mm512_set1_epi32(0xff));
+    const __m512i to = _mm512_and_si512(_mm512_srli_epi32(oriented, 8), _mm512_set1_epi32(0xff));
+    const __m512i pieces =
+      _mm512_xor_si512(_mm512_srli_epi32(raw, 16), _mm512_set1_epi32(swap * 0x11));
+    const __m512i attacked = _mm512_and_si512(pieces, _mm512_set1_epi32(0xf));
+    const __m512i attacker = _mm512_and_si512(_mm512_srli_epi32(pieces, 4), _mm512_set1_epi32(0xf));
+
+    const __m512i lt = _mm512_maskz_set1_epi32(_mm512_cmplt_epi32_mask(from, to), 1);
+    const __m512i pair    = _mm512_or_si512(_mm512_slli_epi32(attacker, 4), attacked);
+    const __m512i lut1Idx = _mm512_add_epi32(_mm512_slli_epi32(pair, 1), lt);
+    const __m512i offsIdx = _mm512_or_si512(_mm512_slli_epi32(attacker, 6), from);
+    const __m512i lut2Idx =
+      _mm512_sub_epi32(_mm512_or_si512(_mm512_slli_epi32(offsIdx, 6), to), _mm512_set1_epi32(3));
+
+    const __m512i index1 = _mm512_mask_i32gather_epi32(zero, mask, lut1Idx, lut1, 4);
+    const __m512i index2 = _mm512_mask_i32gather_epi32(zero, mask, offsIdx, offs, 4);
+    const __m512i index3 = _mm512_mask_i32gather_epi32(zero, mask, lut2Idx, lut2, 1);
+
+    _mm512_storeu_si512(out, _mm512_add_epi32(_mm512_add_epi32(index1, index2),
+                                              _mm512_srli_epi32(index3, 24)));
+    return _mm512_cmplt_epi32_mask(raw, zero);
+    #else
+    static_assert(Lanes == 8);
+
+    const __m256i mask =
+      _mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i raw  = _mm256_maskload_epi32(reinterpret_cast<const int*>(dirties), mask);
+
+    // Orient both squares with a single xor
+    const __m256i oriented = _mm256_xor_si256(raw, _mm256_set1_epi32(orientation * 0x101));
+    const __m256i from     = _mm256_and_si256(oriented, _mm256_set1_epi32(0xff));
+    const __m256i to = _mm256_and_si256(_mm256_srli_epi32(oriented, 8), _mm256_set1_epi32(0xff));
+    const __m256i pieces =
+      _mm256_xor_si256(_mm256_srli_epi32(raw, 16), _mm256_set1_epi32(swap * 0x11));
+    const __m256i attacked = _mm256_and_si256(pieces, _mm256_set1_epi32(0xf));
+    const __m256i attacker = _mm256_and_si256(_mm256_srli_epi32(pieces, 4), _mm256_set1_epi32(0xf));
+
+    // from < to is -1 where true, so it is subtracted
+    const __m256i lt = _mm256_cmpgt_epi32(to, from);
+    const __m256i pair    = _mm256_or_si256(_mm256_slli_epi32(attacker, 4), attacked);
+    const __m256i lut1Idx = _mm256_sub_epi32(_mm256_slli_epi32(pair, 1), lt);
+    const __m256i offsIdx = _mm256_or_si256(_mm256_slli_epi32(attacker, 6), from);
+    const __m256i lut2Idx =
+      _mm256_sub_epi32(_mm256_or_si256(_mm256_slli_epi32(offsIdx, 6), to), _mm256_set1_epi32(3));
+
+    const __m256i index1 = _mm256_mask_i32gather_epi32(zero, lut1, lut1Idx, mask, 4);
+    const __m256i index2 = _mm256_mask_i32gather_epi32(zero, offs, offsIdx, mask, 4);
+    const __m256i index3 = _mm256_mask_i32gather_epi32(zero, lut2, lut2Idx, mask, 1);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                        _mm256_add_epi32(_mm256_add_epi32(index1, index2),
+                                         _mm256_srli_epi32(index3, 24)));
+    return u32(_mm256_movemask_ps(_mm256_castsi256_ps(raw)));
+    #endif
+}
+
+#endif
+
 // Get a list of indices for recently changed features
 
 void FullThreats::append_changed_indices(Color                   perspective,
@@ -274,6 +364,33 @@ void FullThreats::append_changed_indices(Color                   perspective,
                                          const ThreatWeightType* prefetchBase,
                                          IndexType               prefetchStride) {
 
+#if defined(USE_AVX2) && defined(NNUE_THREAT_GATHER)
+    #if defined(USE_AVX512)
+    constexpr int Lanes = 16;
+    #else
+    constexpr int Lanes = 8;
+    #endif
+
+    for (int i = 0; i < diff.list.ssize(); i += Lanes)
+    {
+        const int count = std::min(Lanes, diff.list.ssize() - i);
+
+        alignas(64) IndexType indices[Lanes];
+        const u32 adds =
+          make_indices<Lanes>(perspective, ksq, diff.list.begin() + i, count, indices);
+
+        for (int j = 0; j < count; ++j)
+        {
+            auto&           insert = (adds >> j & 1) ? added : removed;
+            const IndexType index  = indices[j];
+
+            if (prefetchBase)
+                prefetch<PrefetchRw::READ, PrefetchLoc::LOW>(reinterpret_cast<const void*>(
+                  reinterpret_cast<uintptr_t>(prefetchBase) + index * prefetchStride));
+            insert.push_back_if_lt(index, Dimensions);
+        }
+    }
+#else
     for (const auto& dirty : diff.list)
     {
         auto attacker = dirty.pc();
@@ -290,6 +407,7 @@ void FullThreats::append_changed_indices(Color                   perspective,
               reinterpret_cast<uintptr_t>(prefetchBase) + index * prefetchStride));
         insert.push_back_if_lt(index, Dimensions);
     }
+#endif
 }
 
 }  // namespace Stockfish::Eval::NNUE::Features
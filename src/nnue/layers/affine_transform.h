@@ -384,6 +384,97 @@ class AffineTransform {
 #endif
     }
 
+    // Forward propagation of several independent inputs. Inputs are processed in
+    // pairs so that every weight column loaded into registers is applied twice,
+    // halving the weight traffic compared to calling propagate() per input. The
+    // results are identical to those of propagate().
+    void propagate_batch(const InputType* const* inputs,
+                         OutputType* const*      outputs,
+                         IndexType               count) const {
+        IndexType n = 0;
+
+#ifdef ENABLE_SEQ_OPT
+
+        if constexpr (OutputDimensions > 1)
+        {
+    #if defined(USE_AVX512)
+            using vec_t = __m512i;
+        #define vec_set_32 _mm512_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m512_add_dpbusd_epi32
+    #elif defined(USE_AVX2)
+            using vec_t = __m256i;
+        #define vec_set_32 _mm256_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m256_add_dpbusd_epi32
+    #elif defined(USE_SSSE3)
+            using vec_t = __m128i;
+        #define vec_set_32 _mm_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m128_add_dpbusd_epi32
+    #elif defined(USE_NEON_DOTPROD)
+            using vec_t = int32x4_t;
+        #define vec_set_32 vdupq_n_s32
+        #define vec_add_dpbusd_32(acc, a, b) \
+            SIMD::dotprod_m128_add_dpbusd_epi32(acc, vreinterpretq_s8_s32(a), \
+                                                vreinterpretq_s8_s32(b))
+    #elif defined(USE_LASX)
+            using vec_t = __m256i;
+        #define vec_set_32 __lasx_xvreplgr2vr_w
+        #define vec_add_dpbusd_32 SIMD::lasx_m256_add_dpbusd_epi32
+    #elif defined(USE_LSX)
+            using vec_t = __m128i;
+        #define vec_set_32 __lsx_vreplgr2vr_w
+        #define vec_add_dpbusd_32 SIMD::lsx_m128_add_dpbusd_epi32
+    #endif
+
+            static constexpr IndexType OutputSimdWidth = sizeof(vec_t) / sizeof(OutputType);
+
+            static_assert(OutputDimensions % OutputSimdWidth == 0);
+
+            constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / 4;
+            constexpr IndexType NumAccums = OutputDimensions / OutputSimdWidth;
+
+            const vec_t* biasvec = reinterpret_cast<const vec_t*>(biases);
+
+            for (; n + 2 <= count; n += 2)
+            {
+                const InputType* input0 = inputs[n];
+                const InputType* input1 = inputs[n + 1];
+
+                vec_t acc0[NumAccums], acc1[NumAccums];
+                for (IndexType k = 0; k < NumAccums; ++k)
+                    acc0[k] = acc1[k] = biasvec[k];
+
+                for (IndexType i = 0; i < NumChunks; ++i)
+                {
+                    const vec_t in0 = vec_set_32(load_as<i32>(input0 + i * sizeof(i32)));
+                    const vec_t in1 = vec_set_32(load_as<i32>(input1 + i * sizeof(i32)));
+                    const auto  col =
+                      reinterpret_cast<const vec_t*>(&weights[i * OutputDimensions * 4]);
+
+                    for (IndexType k = 0; k < NumAccums; ++k)
+                    {
+                        vec_add_dpbusd_32(acc0[k], in0, col[k]);
+                        vec_add_dpbusd_32(acc1[k], in1, col[k]);
+                    }
+                }
+
+                vec_t* outptr0 = reinterpret_cast<vec_t*>(outputs[n]);
+                vec_t* outptr1 = reinterpret_cast<vec_t*>(outputs[n + 1]);
+                for (IndexType k = 0; k < NumAccums; ++k)
+                {
+                    outptr0[k] = acc0[k];
+                    outptr1[k] = acc1[k];
+                }
+            }
+
+    #undef vec_set_32
+    #undef vec_add_dpbusd_32
+        }
+#endif
+
+        for (; n < count; ++n)
+            propagate(inputs[n], outputs[n]);
+    }
+
    private:
     using BiasType   = OutputType;
     using WeightType = i8;
@@ -22,10 +22,12 @@
 #define NNUE_LAYERS_AFFINE_TRANSFORM_SPARSE_INPUT_H_INCLUDED
 
 #include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <vector>
 
 #include "../../bitboard.h"
 #include "../../memory.h"
@@ -110,6 +112,16 @@ class AffineTransformSparseInput {
         return !stream.fail();
     }
 
+    // Moves the weights of input order[i] to input i
+    void reorder_inputs(const std::array<IndexType, InputDimensions>& order) {
+        const std::vector<WeightType> old(std::begin(weights), std::end(weights));
+
+        for (IndexType o = 0; o < OutputDimensions; ++o)
+            for (IndexType i = 0; i < InputDimensions; ++i)
+                weights[get_weight_index(o * PaddedInputDimensions + i)] =
+                  old[get_weight_index(o * PaddedInputDimensions + order[i])];
+    }
+
     usize get_content_hash() const {
         usize h = 0;
         hash_combine(h, get_raw_data_hash(biases));
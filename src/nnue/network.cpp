@@ -18,7 +18,9 @@
 
 #include "network.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <optional>
@@ -30,6 +32,7 @@
 #include "../incbin/incbin.h"
 
 #include "../evaluate.h"
+#include "../memory.h"
 #include "../misc.h"
 #include "../position.h"
 #include "../types.h"
@@ -64,6 +67,68 @@ namespace Stockfish::Eval::NNUE {
 
 namespace fs = std::filesystem;
 
+// Native network files hold the in-memory image of a Network, with the weights
+// already decompressed and permuted for this build, behind a header padded to
+// NativeAlignment bytes. Loading one is a single copy from a file mapping, but
+// the file is only accepted by builds with the same weight layout.
+static constexpr char  NativeMagic[8]  = {'S', 'F', 'N', 'N', 'U', 'E', 'N', 'T'};
+static constexpr u32   NativeVersion   = 3;
+static constexpr usize NativeAlignment = 64 * 1024;
+
+struct NativeHeader {
+    char magic[8];
+    u32  version;
+    u32  hash;
+    u64  layout;
+    u64  dataOffset;
+    u64  dataBytes;
+    u32  descriptionSize;
+    u8   littleEndian;
+};
+
+// Fingerprint of the compile time settings which change how weights are laid
+// out in memory, i.e. the SIMD flavour the permutations and scrambles target.
+static constexpr u64 native_layout() {
+    u64 flags = Is64Bit;
+#if defined(USE_AVX512)
+    flags |= 1 << 1;
+#endif
+#if defined(USE_AVX2)
+    flags |= 1 << 2;
+#endif
+#if defined(USE_SSSE3)
+    flags |= 1 << 3;
+#endif
+#if defined(USE_SSE2)
+    flags |= 1 << 4;
+#endif
+#if defined(USE_NEON)
+    flags |= 1 << 5;
+#endif
+#if defined(USE_NEON_DOTPROD)
+    flags |= 1 << 6;
+#endif
+#if defined(USE_LSX)
+    flags |= 1 << 7;
+#endif
+#if defined(USE_LASX)
+    flags |= 1 << 8;
+#endif
+#if defined(USE_RVV)
+    flags |= 1 << 9;
+#endif
+#if defined(USE_AVX2_PAIR_ACTIVATIONS)
+    flags |= 1 << 10;
+#endif
+#if defined(USE_VNNI)
+    flags |= 1 << 11;
+#endif
+#if defined(NNUE_THREAT_INT4)
+    flags |= 1 << 12;
+#endif
+    return u64(sizeof(Network)) << 32 | flags;
+}
+
 namespace Detail {
 
 // Read evaluation function parameters
@@ -85,6 +150,20 @@ bool write_parameters(std::ostream& stream, const T& reference) {
     return reference.write_parameters(stream);
 }
 
+// Read the feature transformer, which a build with 4-bit threat weights also
+// accepts in the 8-bit variant
+static bool read_parameters(std::istream& stream, FeatureTransformer& reference, bool int8Threats) {
+
+    const u32 expected = int8Threats ? FeatureTransformer::get_int8_hash_value()
+                                     : FeatureTransformer::get_hash_value();
+
+    u32 header;
+    header = read_little_endian<u32>(stream);
+    if (!stream || header != expected)
+        return false;
+    return reference.read_parameters(stream, int8Threats);
+}
+
 }  // namespace Detail
 
 void Network::load(const fs::path& rootDirectory, fs::path evalfilePath, EvalFile& evalFile) {
@@ -125,6 +204,18 @@ bool Network::save(const EvalFile& evalFile, const std::optional<fs::path>& file
         return false;
     }
 
+#ifdef NNUE_THREAT_INT4
+    // The exported file holds 4-bit threat weights, so it must not take the name
+    // of the embedded net
+    if (!filename.has_value())
+    {
+        sync_cout << "Failed to export a net. A net with 4-bit threat weights can only be "
+                     "saved if the filename is specified"
+                  << sync_endl;
+        return false;
+    }
+#endif
+
     fs::path      actualFilename = filename.value_or(evalFile.defaultName);
     std::ofstream stream(actualFilename, std::ios_base::binary);
 
@@ -137,6 +228,46 @@ bool Network::save(const EvalFile& evalFile, const std::optional<fs::path>& file
     return saved;
 }
 
+// Writes the in-memory image of the network, see NativeHeader. Unlike save(),
+// which writes the portable format, the file is tied to this build's layout.
+bool Network::save_native(const EvalFile& evalFile, const fs::path& filename) const {
+    if (!evalFile.current.has_value())
+    {
+        sync_cout << "Failed to export a net. No network file is currently loaded. "
+                     "Please load a network file first."
+                  << sync_endl;
+        return false;
+    }
+
+    const std::string& description = evalFile.netDescription;
+
+    NativeHeader header{};
+    std::memcpy(header.magic, NativeMagic, sizeof(NativeMagic));
+    header.version         = NativeVersion;
+    header.hash            = Network::hash;
+    header.layout          = native_layout();
+    header.dataOffset      = ceil_to_multiple(sizeof(header) + description.size(), NativeAlignment);
+    header.dataBytes       = sizeof(Network);
+    header.descriptionSize = u32(description.size());
+    header.littleEndian    = IsLittleEndian;
+
+    std::vector<char> headerBytes(header.dataOffset, 0);
+    std::memcpy(headerBytes.data(), &header, sizeof(header));
+    std::memcpy(headerBytes.data() + sizeof(header), description.data(), description.size());
+
+    std::ofstream stream(filename, std::ios_base::binary);
+    stream.write(headerBytes.data(), std::streamsize(headerBytes.size()));
+    stream.write(reinterpret_cast<const char*>(this), std::streamsize(sizeof(Network)));
+
+    const bool saved = bool(stream.flush());
+
+    sync_cout << (saved ? "Network saved successfully to " + filename.string()
+                        : "Failed to export a net")
+              << sync_endl;
+
+    return saved;
+}
+
 NetworkOutput Network::evaluate(const Position&    pos,
                                 AccumulatorStack&  accumulatorStack,
                                 AccumulatorCaches& cache) const {
@@ -149,13 +280,80 @@ NetworkOutput Network::evaluate(const Position&    pos,
 
     NNZInfo<L1> nnzInfo;
 
-    const int  bucket     = (pos.count<ALL_PIECES>() - 1) / 4;
+    const int bucket = (pos.count<ALL_PIECES>() - 1) / 4;
+    network[bucket].prefetch();
+
     const auto psqt       = featureTransformer.transform(pos, accumulatorStack, cache,
                                                          transformedFeatures, bucket, nnzInfo);
     const auto positional = network[bucket].propagate(transformedFeatures, nnzInfo);
     return {static_cast<Value>(psqt / OutputScale), static_cast<Value>(positional / OutputScale)};
 }
 
+void Network::evaluate_batch(const Position* const* positions,
+                             usize                  count,
+                             AccumulatorStack&      accumulatorStack,
+                             AccumulatorCaches&     cache,
+                             NetworkOutput*         outputs) const {
+
+    constexpr u64       alignment = CacheLineSize;
+    constexpr IndexType BatchSize = NetworkArchitecture::MaxBatchSize;
+
+    alignas(alignment)
+      TransformedFeatureType transformedFeatures[BatchSize][FeatureTransformer::BufferSize];
+
+    ASSERT_ALIGNED(transformedFeatures, alignment);
+
+    NNZInfo<L1> nnzInfos[BatchSize];
+    i32         psqts[BatchSize];
+    int         buckets[BatchSize];
+
+    for (usize base = 0; base < count; base += BatchSize)
+    {
+        const IndexType size = IndexType(std::min<usize>(BatchSize, count - base));
+
+        // The positions are unrelated, so each one is refreshed from the root of
+        // the stack. The caches still help when consecutive positions share kings.
+        for (IndexType i = 0; i < size; ++i)
+        {
+            const Position& pos = *positions[base + i];
+
+            accumulatorStack.reset();
+            nnzInfos[i] = NNZInfo<L1>{};
+            buckets[i]  = (pos.count<ALL_PIECES>() - 1) / 4;
+            psqts[i]    = featureTransformer.transform(pos, accumulatorStack, cache,
+                                                       transformedFeatures[i], buckets[i],
+                                                       nnzInfos[i]);
+        }
+
+        for (IndexType bucket = 0; bucket < LayerStacks; ++bucket)
+        {
+            const TransformedFeatureType* features[BatchSize];
+            const NNZInfo<L1>*            nnz[BatchSize];
+            IndexType                     members[BatchSize];
+            i32                           positional[BatchSize];
+            IndexType                     groupSize = 0;
+
+            for (IndexType i = 0; i < size; ++i)
+                if (buckets[i] == int(bucket))
+                {
+                    features[groupSize] = transformedFeatures[i];
+                    nnz[groupSize]      = &nnzInfos[i];
+                    members[groupSize]  = i;
+                    ++groupSize;
+                }
+
+            if (!groupSize)
+                continue;
+
+            network[bucket].propagate_batch(features, nnz, groupSize, positional);
+
+            for (IndexType j = 0; j < groupSize; ++j)
+                outputs[base + members[j]] = {static_cast<Value>(psqts[members[j]] / OutputScale),
+                                              static_cast<Value>(positional[j] / OutputScale)};
+        }
+    }
+}
+
 
 void Network::verify(const std::function<void(std::string_view)>& f,
                      const EvalFile&                              evalFile,
@@ -228,6 +426,14 @@ NnueEvalTrace Network::trace_evaluate(const Position&    pos,
 
 
 void Network::load_external(const fs::path& dir, const fs::path& evalfilePath, EvalFile& evalFile) {
+    std::string nativeDescription;
+    if (load_native(dir / evalfilePath, nativeDescription))
+    {
+        evalFile.current        = evalfilePath;
+        evalFile.netDescription = nativeDescription;
+        return;
+    }
+
     std::ifstream stream(dir / evalfilePath, std::ios::binary);
     auto          description = load(stream);
 
@@ -280,19 +486,64 @@ std::optional<std::string> Network::load(std::istream& stream) {
     initialize();
     std::string description;
 
-    return read_parameters(stream, description) ? std::make_optional(description) : std::nullopt;
+    if (!read_parameters(stream, description))
+        return std::nullopt;
+
+    hash_content();
+    return description;
+}
+
+
+// Loads a file written by save_native(). The header is validated before the
+// network is touched, so any other file leaves it unchanged and returns false.
+bool Network::load_native(const fs::path& file, std::string& description) {
+    std::ifstream stream(file, std::ios::binary);
+    NativeHeader  header{};
+
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, NativeMagic, sizeof(NativeMagic))
+        || header.version != NativeVersion || header.hash != Network::hash
+        || header.layout != native_layout() || header.dataBytes != sizeof(Network)
+        || header.littleEndian != IsLittleEndian || header.dataOffset % NativeAlignment)
+        return false;
+
+    description.resize(header.descriptionSize);
+    if (!stream.read(description.data(), header.descriptionSize))
+        return false;
+
+    stream.seekg(0, std::ios::end);
+    const usize fileSize = stream ? usize(stream.tellg()) : 0;
+    if (fileSize < header.dataOffset + sizeof(Network))
+        return false;
+
+    if (void* mem = map_file_private(file, header.dataOffset, sizeof(Network)))
+    {
+        std::memcpy(static_cast<void*>(this), mem, sizeof(Network));
+        unmap_file(mem, sizeof(Network));
+    }
+    else
+    {
+        stream.seekg(std::streamoff(header.dataOffset));
+        if (!stream.read(reinterpret_cast<char*>(this), sizeof(Network)))
+            return false;
+    }
+
+    initialize();
+    return true;
 }
 
 
-usize Network::get_content_hash() const {
-    if (!initialized)
-        return 0;
+usize Network::get_content_hash() const { return initialized ? contentHash : 0; }
 
+// Hashing the weights takes about as long as reading them, so it is done once
+// per load, and shared memory lookups of the replicas reuse the result. Native
+// images carry it along with the weights.
+void Network::hash_content() {
     usize h = 0;
     hash_combine(h, featureTransformer);
     for (auto&& layerstack : network)
         hash_combine(h, layerstack);
-    return h;
+    contentHash = h;
 }
 
 // Read network header
@@ -324,9 +575,15 @@ bool Network::read_parameters(std::istream& stream, std::string& netDescription)
     u32 hashValue;
     if (!read_header(stream, &hashValue, &netDescription))
         return false;
-    if (hashValue != Network::hash)
+
+    bool int8Threats = false;
+#ifdef NNUE_THREAT_INT4
+    int8Threats = hashValue == Network::int8Hash;
+#endif
+
+    if (hashValue != Network::hash && !int8Threats)
         return false;
-    if (!Detail::read_parameters(stream, featureTransformer))
+    if (!Detail::read_parameters(stream, featureTransformer, int8Threats))
         return false;
     for (usize i = 0; i < LayerStacks; ++i)
     {
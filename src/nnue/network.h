@@ -31,8 +31,10 @@
 #include "../types.h"
 #include "../misc.h"
 #include "nnue_architecture.h"
+#include "nnue_bench.h"
 #include "nnue_feature_transformer.h"
 #include "nnue_misc.h"
+#include "nnue_reorder.h"
 
 namespace Stockfish {
 class Position;
@@ -62,6 +64,7 @@ class Network {
               std::filesystem::path        evalfilePath,
               EvalFile&                    evalFile);
     bool save(const EvalFile& evalFile, const std::optional<std::filesystem::path>& filename) const;
+    bool save_native(const EvalFile& evalFile, const std::filesystem::path& filename) const;
 
     usize get_content_hash() const;
 
@@ -69,6 +72,13 @@ class Network {
                            AccumulatorStack&  accumulatorStack,
                            AccumulatorCaches& cache) const;
 
+    // Evaluates many unrelated positions, grouping them by layer stack bucket so
+    // the dense layers run over several positions per weight pass.
+    void evaluate_batch(const Position* const* positions,
+                        usize                  count,
+                        AccumulatorStack&      accumulatorStack,
+                        AccumulatorCaches&     cache,
+                        NetworkOutput*         outputs) const;
 
     void verify(const std::function<void(std::string_view)>& f,
                 const EvalFile&                              evalFile,
@@ -83,9 +93,11 @@ class Network {
 
    private:
     void initialize();
+    void hash_content();
 
     bool                       save(std::ostream&, const std::string&) const;
     std::optional<std::string> load(std::istream&);
+    bool                       load_native(const std::filesystem::path&, std::string&);
 
     bool read_header(std::istream&, u32*, std::string*) const;
     bool write_header(std::ostream&, u32, const std::string&) const;
@@ -99,13 +111,23 @@ class Network {
     // Evaluation function
     NetworkArchitecture network[LayerStacks];
 
-    bool initialized = false;
+    bool  initialized = false;
+    usize contentHash = 0;
 
     // Hash value of evaluation function structure
     static constexpr u32 hash =
       FeatureTransformer::get_hash_value() ^ NetworkArchitecture::get_hash_value();
 
+#ifdef NNUE_THREAT_INT4
+    // Hash value of the variant with 8-bit threat weights, quantized on load
+    static constexpr u32 int8Hash =
+      FeatureTransformer::get_int8_hash_value() ^ NetworkArchitecture::get_hash_value();
+#endif
+
     friend struct AccumulatorCaches;
+    friend std::string stage_benchmark(const Network&, int);
+    friend std::optional<std::string>
+    reorder_neurons(Network&, const std::vector<std::string>&, bool, std::string&);
 };
 
 
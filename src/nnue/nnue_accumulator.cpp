@@ -22,6 +22,7 @@
 #include <new>
 
 #include "../bitboard.h"
+#include "../memory.h"
 #include "../misc.h"
 #include "../position.h"
 #include "../types.h"
@@ -48,6 +49,86 @@ void update_accumulator_refresh_cache(Color                     perspective,
                                       const Position&           pos,
                                       AccumulatorState&         accumulatorState,
                                       AccumulatorCaches&        cache);
+
+Bitboard get_changed_pieces(const std::array<Piece, SQUARE_NB>& oldPieces,
+                            const std::array<Piece, SQUARE_NB>& newPieces);
+
+// Costs of the update paths, counted in rows of weights which are added to or
+// subtracted from the accumulator. Loading and storing whole accumulators is
+// charged as a couple of rows. An active threat costs a refresh more than its
+// row: its index is generated from scratch, and the states skipped between the
+// ancestor and the latest one must be recomputed for every sibling searched.
+constexpr int PlyCost          = 2;
+constexpr int RefreshCost      = 16;
+constexpr int ActiveThreatCost = 3;
+
+// Pawn pairs are formed with the pawns on nearby squares, see PP_3Wide
+constexpr int PairsPerPawn = 3;
+}
+
+// Resizes the store to mbSize MiB, which disables it when zero. The thread
+// that calls this first touches the keys, the entries are first touched by
+// the search thread that saves them.
+void AccumulatorStore::resize(usize mbSize) {
+
+    const usize newCount = (mbSize * 1024 * 1024 / (sizeof(Entry) + sizeof(Key))) & ~usize(1);
+
+    if (newCount != count)
+    {
+        table.reset();
+        keys.reset();
+        count = newCount;
+        if (count)
+        {
+            table = make_unique_aligned<Entry[]>(count);
+            keys  = make_unique_aligned<Key[]>(count);
+        }
+    }
+
+    clear();
+}
+
+void AccumulatorStore::clear() {
+    if (count)
+        std::memset(static_cast<void*>(keys.get()), 0, count * sizeof(Key));
+}
+
+bool AccumulatorStore::probe(Key key, Color perspective, Accumulator& accumulator) const {
+
+    const usize idx = index(key, perspective);
+    if (keys[idx] != key)
+        return false;
+
+    const Entry& e                            = table[idx];
+    accumulator.accumulation[perspective]     = e.accumulation;
+    accumulator.psqtAccumulation[perspective] = e.psqtAccumulation;
+    accumulator.threatCount[perspective]      = e.threatCount;
+    accumulator.computed[perspective]         = true;
+    return true;
+}
+
+// Most states are never needed again, and copying each of them out to memory
+// costs about as much as a hit saves. A position is only admitted on its second
+// visit, the first one just leaves its key inverted, which no probe matches.
+void AccumulatorStore::save(Key key, Color perspective, const Accumulator& accumulator) {
+
+    const usize idx = index(key, perspective);
+
+    // The state may have been copied out of this very entry
+    if (keys[idx] == key)
+        return;
+
+    if (keys[idx] != ~key)
+    {
+        keys[idx] = ~key;
+        return;
+    }
+
+    Entry& e           = table[idx];
+    e.accumulation     = accumulator.accumulation[perspective];
+    e.psqtAccumulation = accumulator.psqtAccumulation[perspective];
+    e.threatCount      = accumulator.threatCount[perspective];
+    keys[idx]          = key;
 }
 
 const AccumulatorState& AccumulatorStack::latest() const noexcept { return accumulators[size - 1]; }
@@ -59,6 +140,8 @@ void AccumulatorStack::reset() noexcept {
     new (&accumulators[0].dirtyThreats) DirtyThreats;
     new (&accumulators[0].dirtyPawnPairs) DirtyPawnPairs;
     accumulators[0].computed.fill(false);
+    accumulators[0].childComputed.fill(false);
+    accumulators[0].key = 0;
     size = 1;
 }
 
@@ -66,14 +149,35 @@ Dirties& AccumulatorStack::push() noexcept {
     assert(size < MaxSize);
     auto& st = accumulators[size];
     st.computed.fill(false);
+    st.childComputed.fill(false);
     new (&st.dirtyThreats) DirtyThreats;
     new (&st.dirtyPawnPairs) DirtyPawnPairs;
     size++;
     return st;
 }
 
-void AccumulatorStack::pop() noexcept {
+// Leaves the latest state. A node reached again usually gets its eval from the
+// TT, so its accumulator is only needed once more as the parent of the children
+// it searches, which must otherwise be replayed from an older ancestor or
+// refreshed. Leaves are never offered to the store, only the states with a
+// computed child.
+void AccumulatorStack::pop(AccumulatorStore& store) noexcept {
     assert(size > 1);
+
+    if (store.enabled())
+    {
+        const AccumulatorState& st     = accumulators[size - 1];
+        AccumulatorState&       parent = accumulators[size - 2];
+
+        for (Color perspective : {WHITE, BLACK})
+        {
+            if (st.computed[perspective] && st.childComputed[perspective])
+                store.save(st.key, perspective, st);
+
+            parent.childComputed[perspective] |= st.computed[perspective];
+        }
+    }
+
     size--;
 }
 
@@ -90,18 +194,89 @@ void AccumulatorStack::evaluate_side(Color                     perspective,
                                      const FeatureTransformer& featureTransformer,
                                      AccumulatorCaches&        cache) noexcept {
 
-    const auto last_usable_accum = find_last_usable_accumulator(perspective);
+    auto last_usable_accum = find_last_usable_accumulator(perspective);
 
-    if (accumulators[last_usable_accum].computed[perspective])
-        forward_update_incremental(perspective, pos, featureTransformer, last_usable_accum);
+    if (last_usable_accum == size - 1 && latest().computed[perspective])
+        return;
+
+    // Before replaying or refreshing, look for the latest state or one of those
+    // in between in the store. They were likely computed when first searched, and
+    // skipped later on because the TT held their eval.
+    if (cache.store.enabled()
+        && !(accumulators[last_usable_accum].computed[perspective]
+             && last_usable_accum == size - 2))
+        for (usize i = size - 1; i > 0 && i >= last_usable_accum; --i)
+            if (!accumulators[i].computed[perspective]
+                && cache.store.probe(accumulators[i].key, perspective, accumulators[i]))
+            {
+                ++pathCounts[UPDATE_STORE];
+                last_usable_accum = i;
+                break;
+            }
+
+    if (last_usable_accum == size - 1 && latest().computed[perspective])
+        return;
+
+    const bool incremental =
+      accumulators[last_usable_accum].computed[perspective] && last_usable_accum == size - 2;
 
+    // Replaying the moves from a computed ancestor also computes every state in
+    // between, but with threat features a single capture may change dozens of
+    // them, so along a long line of captures a refresh of the latest state can
+    // be cheaper. A single ply is always cheaper to update.
+    if (incremental
+        || (accumulators[last_usable_accum].computed[perspective]
+            && replay_cost(last_usable_accum)
+                 <= refresh_cost(perspective, pos, cache, last_usable_accum)))
+    {
+        ++pathCounts[incremental ? UPDATE_INCREMENTAL : UPDATE_REPLAY];
+        forward_update_incremental(perspective, pos, featureTransformer, last_usable_accum);
+    }
     else
     {
+        ++pathCounts[UPDATE_REFRESH];
         update_accumulator_refresh_cache(perspective, featureTransformer, pos, mut_latest(), cache);
-        backward_update_incremental(perspective, pos, featureTransformer, last_usable_accum);
+
+        // Past a king move, the states up to it can only be computed backwards
+        if (!accumulators[last_usable_accum].computed[perspective])
+            backward_update_incremental(perspective, pos, featureTransformer, last_usable_accum);
     }
 }
 
+// Estimates the cost of replaying the moves after the computed state at begin
+int AccumulatorStack::replay_cost(usize begin) const noexcept {
+
+    int cost = 0;
+
+    for (usize next = begin + 1; next < size; ++next)
+    {
+        const DirtyPiece&     dp    = accumulators[next].dirtyPiece;
+        const DirtyPawnPairs& pairs = accumulators[next].dirtyPawnPairs;
+
+        const Bitboard movedPawns = (pairs.before[WHITE] ^ pairs.after[WHITE])
+                                  | (pairs.before[BLACK] ^ pairs.after[BLACK]);
+
+        cost += PlyCost + 1 + (dp.to != SQ_NONE) + (dp.remove_sq != SQ_NONE)
+              + (dp.add_sq != SQ_NONE) + accumulators[next].dirtyThreats.list.ssize()
+              + PairsPerPawn * popcount(movedPawns);
+    }
+
+    return cost;
+}
+
+// Estimates the cost of a refresh from the Finny table. The threat features
+// are all added again, their count is taken from the computed state at begin.
+int AccumulatorStack::refresh_cost(Color                    perspective,
+                                   const Position&          pos,
+                                   const AccumulatorCaches& cache,
+                                   usize                    begin) const noexcept {
+
+    const auto& entry = cache[pos.square<KING>(perspective)][perspective];
+
+    return RefreshCost + popcount(get_changed_pieces(entry.pieces, pos.piece_array()))
+         + ActiveThreatCost * accumulators[begin].threatCount[perspective];
+}
+
 // Find the earliest usable accumulator, this can either be a computed accumulator or the accumulator
 // state just before a change that requires full refresh.
 usize AccumulatorStack::find_last_usable_accumulator(Color perspective) const noexcept {
@@ -157,6 +332,32 @@ void AccumulatorStack::backward_update_incremental(Color                     per
 
 namespace {
 
+#if defined(VECTOR) && defined(NNUE_THREAT_INT4)
+// Adds or subtracts one tile of a 4-bit threat or pawn-pair weight row. Each
+// group of packed bytes sign-extends to 16 bits once, then the low nibbles go
+// to register k and the high nibbles to register k + 1 before scaling.
+template<bool Add, int NumRegs>
+inline void accumulate_threat_tile(vec_t* acc, const u8* tile, i16 scale) {
+    static_assert(NumRegs % 2 == 0, "Packed threat weights fill registers in pairs");
+
+    const vec_t scales = vec_set_16(scale);
+
+    for (int k = 0; k < NumRegs; k += 2)
+    {
+    #ifdef USE_NEON
+        const vec_t bytes = vmovl_s8(vld1_s8(reinterpret_cast<const i8*>(tile) + k / 2 * 8));
+    #else
+        const vec_t bytes = vec_convert_8_16(reinterpret_cast<const vec_i8_t*>(tile)[k / 2]);
+    #endif
+        const vec_t lo = vec_mullo_16(vec_srai_16(vec_slli_16(bytes, 12), 12), scales);
+        const vec_t hi = vec_mullo_16(vec_srai_16(bytes, 4), scales);
+
+        acc[k]     = Add ? vec_add_16(acc[k], lo) : vec_sub_16(acc[k], lo);
+        acc[k + 1] = Add ? vec_add_16(acc[k + 1], hi) : vec_sub_16(acc[k + 1], hi);
+    }
+}
+#endif
+
 void apply_combined(Color                              perspective,
                     const FeatureTransformer&          featureTransformer,
                     const AccumulatorState&            from,
@@ -209,35 +410,47 @@ void apply_combined(Color                              perspective,
 
         for (int i = 0; i < thrRemoved.ssize(); ++i)
         {
+    #ifdef NNUE_THREAT_INT4
+            accumulate_threat_tile<false, Tiling::NumRegs>(
+              acc, &threatAndPpWeights[(thrRemoved[i] * Dimensions + tileOff) / 2],
+              featureTransformer.threatAndPpScales[thrRemoved[i]]);
+    #else
             auto* column = reinterpret_cast<const vec_i8_t*>(
               &threatAndPpWeights[thrRemoved[i] * Dimensions + tileOff]);
 
-    #ifdef USE_NEON
+        #ifdef USE_NEON
             for (IndexType k = 0; k < Tiling::NumRegs; k += 2)
             {
                 acc[k]     = vsubw_s8(acc[k], vget_low_s8(column[k / 2]));
                 acc[k + 1] = vsubw_high_s8(acc[k + 1], column[k / 2]);
             }
-    #else
+        #else
             for (IndexType k = 0; k < Tiling::NumRegs; ++k)
                 acc[k] = vec_sub_16(acc[k], vec_convert_8_16(column[k]));
+        #endif
     #endif
         }
 
         for (int i = 0; i < thrAdded.ssize(); ++i)
         {
+    #ifdef NNUE_THREAT_INT4
+            accumulate_threat_tile<true, Tiling::NumRegs>(
+              acc, &threatAndPpWeights[(thrAdded[i] * Dimensions + tileOff) / 2],
+              featureTransformer.threatAndPpScales[thrAdded[i]]);
+    #else
             auto* column = reinterpret_cast<const vec_i8_t*>(
               &threatAndPpWeights[thrAdded[i] * Dimensions + tileOff]);
 
-    #ifdef USE_NEON
+        #ifdef USE_NEON
             for (IndexType k = 0; k < Tiling::NumRegs; k += 2)
             {
                 acc[k]     = vaddw_s8(acc[k], vget_low_s8(column[k / 2]));
                 acc[k + 1] = vaddw_high_s8(acc[k + 1], column[k / 2]);
             }
-    #else
+        #else
             for (IndexType k = 0; k < Tiling::NumRegs; ++k)
                 acc[k] = vec_add_16(acc[k], vec_convert_8_16(column[k]));
+        #endif
     #endif
         }
 
@@ -291,7 +504,7 @@ void apply_combined(Color                              perspective,
             vec_store_psqt(&toTilePsqt[k], psqt[k]);
     }
 
-#elif defined(USE_RVV)
+#elif defined(USE_RVV) && !defined(NNUE_THREAT_INT4)
 
     usize tileOffset = 0;
 
@@ -374,18 +587,16 @@ void apply_combined(Color                              perspective,
 
     for (const auto index : thrRemoved)
     {
-        const IndexType offset = Dimensions * index;
         for (IndexType j = 0; j < Dimensions; ++j)
-            toAcc[j] -= featureTransformer.threatAndPpWeights[offset + j];
+            toAcc[j] -= featureTransformer.threat_weight(index, j);
         for (usize k = 0; k < PSQTBuckets; ++k)
             toPsqtAcc[k] -= featureTransformer.threatAndPpPsqtWeights[index * PSQTBuckets + k];
     }
 
     for (const auto index : thrAdded)
     {
-        const IndexType offset = Dimensions * index;
         for (IndexType j = 0; j < Dimensions; ++j)
-            toAcc[j] += featureTransformer.threatAndPpWeights[offset + j];
+            toAcc[j] += featureTransformer.threat_weight(index, j);
         for (usize k = 0; k < PSQTBuckets; ++k)
             toPsqtAcc[k] += featureTransformer.threatAndPpPsqtWeights[index * PSQTBuckets + k];
     }
@@ -414,9 +625,11 @@ void update_accumulator_incremental(Color                     perspective,
     const auto& dirtyThreats   = Forward ? target_state.dirtyThreats : computed.dirtyThreats;
     const auto& dirtyPawnPairs = Forward ? target_state.dirtyPawnPairs : computed.dirtyPawnPairs;
 
-    // Used solely for prefetching
-    const auto* threatPpBase = &featureTransformer.threatAndPpWeights[0];
-    IndexType   pfStride     = FeatureTransformer::OutputDimensions;
+    // Used solely for prefetching, the stride is the size of a row in bytes
+    const auto* threatPpBase =
+      reinterpret_cast<const ThreatWeightType*>(&featureTransformer.threatAndPpWeights[0]);
+    IndexType pfStride =
+      sizeof(featureTransformer.threatAndPpWeights) / FeatureTransformer::ThreatWeightRows;
 
     if constexpr (Forward)
     {
@@ -438,6 +651,8 @@ void update_accumulator_incremental(Color                     perspective,
     apply_combined(perspective, featureTransformer, computed, target_state, psqAdded, psqRemoved,
                    thrAdded, thrRemoved);
 
+    target_state.threatCount[perspective] =
+      u16(computed.threatCount[perspective] + thrAdded.ssize() - thrRemoved.ssize());
     target_state.computed[perspective] = true;
 }
 
@@ -586,7 +801,8 @@ void update_accumulator_refresh_cache(Color                     perspective,
     ThreatFeatureSet::append_active_indices(perspective, pos, active);
     PairFeatureSet::append_active_indices(perspective, pos, active);
 
-    accumulator.computed[perspective] = true;
+    accumulator.threatCount[perspective] = u16(active.size());
+    accumulator.computed[perspective]    = true;
 
 #ifdef VECTOR
     vec_t      acc[Tiling::NumRegs];
@@ -624,18 +840,24 @@ void update_accumulator_refresh_cache(Color                     perspective,
 
         for (int i = 0; i < active.ssize(); ++i)
         {
+    #ifdef NNUE_THREAT_INT4
+            accumulate_threat_tile<true, Tiling::NumRegs>(
+              acc, &threatAndPpWeights[(active[i] * Dimensions + tileOff) / 2],
+              featureTransformer.threatAndPpScales[active[i]]);
+    #else
             auto* column = reinterpret_cast<const vec_i8_t*>(
               &threatAndPpWeights[active[i] * Dimensions + tileOff]);
 
-    #ifdef USE_NEON
+        #ifdef USE_NEON
             for (IndexType k = 0; k < Tiling::NumRegs; k += 2)
             {
                 acc[k]     = vaddw_s8(acc[k], vget_low_s8(column[k / 2]));
                 acc[k + 1] = vaddw_high_s8(acc[k + 1], column[k / 2]);
             }
-    #else
+        #else
             for (IndexType k = 0; k < Tiling::NumRegs; ++k)
                 acc[k] = vec_add_16(acc[k], vec_convert_8_16(column[k]));
+        #endif
     #endif
         }
 
@@ -683,7 +905,7 @@ void update_accumulator_refresh_cache(Color                     perspective,
             vec_store_psqt(&accTilePsqt[k], psqt[k]);
     }
 
-#elif defined(USE_RVV)
+#elif defined(USE_RVV) && !defined(NNUE_THREAT_INT4)
 
     const auto* weights           = &featureTransformer.weights[0];
     const auto* threatWeights     = &featureTransformer.threatAndPpWeights[0];
@@ -769,11 +991,8 @@ void update_accumulator_refresh_cache(Color                     perspective,
 
     for (const auto index : active)
     {
-        const IndexType offset = Dimensions * index;
-
         for (IndexType j = 0; j < Dimensions; ++j)
-            accumulator.accumulation[perspective][j] +=
-              featureTransformer.threatAndPpWeights[offset + j];
+            accumulator.accumulation[perspective][j] += featureTransformer.threat_weight(index, j);
 
         for (usize k = 0; k < PSQTBuckets; ++k)
             accumulator.psqtAccumulation[perspective][k] +=
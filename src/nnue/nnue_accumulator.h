@@ -25,6 +25,7 @@
 #include <cstddef>
 #include <cstring>
 
+#include "../memory.h"
 #include "../types.h"
 #include "../misc.h"
 #include "nnue_architecture.h"
@@ -46,6 +47,58 @@ struct alignas(CacheLineSize) Accumulator {
     std::array<std::array<i16, L1>, COLOR_NB>          accumulation;
     std::array<std::array<i32, PSQTBuckets>, COLOR_NB> psqtAccumulation;
     std::array<bool, COLOR_NB>                         computed = {};
+
+    // Number of active threat and pawn pair features, valid once computed
+    std::array<u16, COLOR_NB> threatCount;
+};
+
+// The ways AccumulatorStack::evaluate_side brings the latest accumulator of
+// a perspective up to date, counted for statistics
+enum UpdatePath {
+    UPDATE_INCREMENTAL,  // Update from the computed parent
+    UPDATE_REPLAY,       // Replay the moves from an older computed ancestor
+    UPDATE_REFRESH,      // Refresh from the Finny table entry
+    UPDATE_STORE,        // Copy from the AccumulatorStore
+    UPDATE_PATH_NB
+};
+
+using UpdatePathCounts = std::array<u64, UPDATE_PATH_NB>;
+
+
+// AccumulatorStore is an optional per-thread table of the accumulators of
+// searched nodes, one perspective per entry, so that a position reached again
+// through another move order can be copied in instead of being replayed from
+// an ancestor or refreshed. An entry holds the threat and pawn pair features
+// along with the HalfKA ones, all of which only depend on the position, so
+// it is keyed by the Zobrist key. It must be cleared when the network changes.
+class AccumulatorStore {
+   public:
+    void resize(usize mbSize);
+    void clear();
+    bool enabled() const { return count != 0; }
+
+    bool probe(Key key, Color perspective, Accumulator& accumulator) const;
+    void save(Key key, Color perspective, const Accumulator& accumulator);
+
+   private:
+    // Entries span whole cache lines, the two perspectives of a position are
+    // stored next to each other. The keys are kept apart, so that a probe that
+    // misses, as most do, only reads a small table that mostly stays in cache.
+    struct alignas(CacheLineSize) Entry {
+        std::array<i16, L1>          accumulation;
+        std::array<i32, PSQTBuckets> psqtAccumulation;
+        u16                          threatCount;
+    };
+
+    static_assert(sizeof(Entry) % CacheLineSize == 0);
+
+    usize index(Key key, Color perspective) const {
+        return 2 * mul_hi64(key, count / 2) + perspective;
+    }
+
+    AlignedPtr<Entry[]> table;
+    AlignedPtr<Key[]>   keys;
+    usize               count = 0;
 };
 
 
@@ -81,15 +134,26 @@ struct AccumulatorCaches {
         for (auto& entries1D : entries)
             for (auto& entry : entries1D)
                 entry.clear(network.featureTransformer.biases);
+
+        store.clear();
     }
 
-    std::array<Entry, COLOR_NB>& operator[](Square sq) { return entries[sq]; }
+    std::array<Entry, COLOR_NB>&       operator[](Square sq) { return entries[sq]; }
+    const std::array<Entry, COLOR_NB>& operator[](Square sq) const { return entries[sq]; }
 
     std::array<std::array<Entry, COLOR_NB>, SQUARE_NB> entries;
+
+    // Empty unless sized by the search, see the AccumulatorStore UCI option
+    AccumulatorStore store;
 };
 
 
-struct AccumulatorState: public Accumulator, Dirties {};
+struct AccumulatorState: public Accumulator, Dirties {
+    Key key;  // Set by the search, which enables the AccumulatorStore
+
+    // Whether a child of this state was computed, see AccumulatorStack::pop()
+    std::array<bool, COLOR_NB> childComputed;
+};
 
 class AccumulatorStack {
    public:
@@ -99,13 +163,19 @@ class AccumulatorStack {
 
     void     reset() noexcept;
     Dirties& push() noexcept;
-    void     pop() noexcept;
+    void     pop(AccumulatorStore& store) noexcept;
+
+    // Keys the latest state for the AccumulatorStore, after the move is made
+    void set_key(Key key) noexcept { mut_latest().key = key; }
 
     void evaluate(const Position&           pos,
                   const FeatureTransformer& featureTransformer,
                   // Silence spurious warning on GCC 10
                   [[maybe_unused]] AccumulatorCaches& cache) noexcept;
 
+    const UpdatePathCounts& path_counts() const noexcept { return pathCounts; }
+    void                    clear_path_counts() noexcept { pathCounts = {}; }
+
    private:
     [[nodiscard]] AccumulatorState& mut_latest() noexcept;
 
@@ -117,6 +187,13 @@ class AccumulatorStack {
 
     [[nodiscard]] usize find_last_usable_accumulator(Color perspective) const noexcept;
 
+    [[nodiscard]] int replay_cost(usize begin) const noexcept;
+
+    [[nodiscard]] int refresh_cost(Color                    perspective,
+                                   const Position&          pos,
+                                   const AccumulatorCaches& cache,
+                                   usize                    begin) const noexcept;
+
     void forward_update_incremental(Color                     perspective,
                                     const Position&           pos,
                                     const FeatureTransformer& featureTransformer,
@@ -129,6 +206,7 @@ class AccumulatorStack {
 
     std::array<AccumulatorState, MaxSize> accumulators;
     usize                                 size = 1;
+    UpdatePathCounts                      pathCounts{};
 };
 
 }  // namespace Stockfish::Eval::NNUE
@@ -21,6 +21,8 @@
 #ifndef NNUE_ARCHITECTURE_H_INCLUDED
 #define NNUE_ARCHITECTURE_H_INCLUDED
 
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
 
@@ -55,7 +57,10 @@ constexpr IndexType LayerStacks = 8;
 static_assert(PSQTBuckets % 8 == 0,
               "Per feature PSQT values cannot be processed at granularity lower than 8 at a time.");
 
-struct NetworkArchitecture {
+// Each layer stack starts on a page of its own. The dense layers and the fc_0
+// biases come first, so that the part read in full by every evaluation fits in
+// one page, and the sparsely read fc_0 weights follow.
+struct alignas(4096) NetworkArchitecture {
     static constexpr IndexType TransformedFeatureDimensions = L1;
     static constexpr int       FC_0_OUTPUTS                 = L2;
     static constexpr int       FC_1_OUTPUTS                 = L3;
@@ -65,13 +70,27 @@ struct NetworkArchitecture {
     static constexpr bool UsePairedActivations = false;
 #endif
 
+    Layers::AffineTransform<FC_0_OUTPUTS * 2, FC_1_OUTPUTS, UsePairedActivations>         fc_1;
+    Layers::AffineTransform<FC_0_OUTPUTS * 2 + FC_1_OUTPUTS * 2, 1, UsePairedActivations> fc_2;
     Layers::AffineTransformSparseInput<TransformedFeatureDimensions, FC_0_OUTPUTS>        fc_0;
     Layers::SqrClippedReLU<FC_0_OUTPUTS, WeightScaleBits + 1>                             ac_sqr_0;
     Layers::ClippedReLU<FC_0_OUTPUTS, WeightScaleBits + 1>                                ac_0;
-    Layers::AffineTransform<FC_0_OUTPUTS * 2, FC_1_OUTPUTS, UsePairedActivations>         fc_1;
     Layers::SqrClippedReLU<FC_1_OUTPUTS, WeightScaleBits>                                 ac_sqr_1;
     Layers::ClippedReLU<FC_1_OUTPUTS, WeightScaleBits>                                    ac_1;
-    Layers::AffineTransform<FC_0_OUTPUTS * 2 + FC_1_OUTPUTS * 2, 1, UsePairedActivations> fc_2;
+
+    // Brings everything but the fc_0 weights into cache. Called as soon as the
+    // bucket is known, so that the loads overlap the accumulator update.
+    void prefetch() const {
+        // The fc_0 biases are the first member of fc_0
+        constexpr usize DenseBytes =
+          offsetof(NetworkArchitecture, fc_0)
+          + decltype(fc_0)::OutputDimensions * sizeof(typename decltype(fc_0)::OutputType);
+        static_assert(DenseBytes <= 4096);
+
+        const char* base = reinterpret_cast<const char*>(this);
+        for (usize offset = 0; offset < DenseBytes; offset += CacheLineSize)
+            Stockfish::prefetch(base + offset);
+    }
 
     // Hash value embedded in the evaluation file
     static constexpr u32 get_hash_value() {
@@ -104,19 +123,63 @@ struct NetworkArchitecture {
             && fc_2.write_parameters(stream);
     }
 
+    // Largest group of positions accepted by propagate_batch()
+    static constexpr IndexType MaxBatchSize = 16;
+
+    // Intermediate results of one forward pass
+    struct alignas(CacheLineSize) Buffer {
+        alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
+        alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
+          concat_buffer[ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2 + FC_1_OUTPUTS * 2, 32)];
+        alignas(CacheLineSize) typename decltype(fc_1)::OutputBuffer fc_1_out;
+        alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
+    };
+
     i32 propagate(const TransformedFeatureType* transformedFeatures,
                   const NNZInfo<L1>&            nnzInfo) const {
-        struct alignas(CacheLineSize) Buffer {
-            alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
-            alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
-              concat_buffer[ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2 + FC_1_OUTPUTS * 2, 32)];
-            alignas(CacheLineSize) typename decltype(fc_1)::OutputBuffer fc_1_out;
-            alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
-        };
-
         Buffer buffer;
 
         fc_0.propagate(transformedFeatures, buffer.fc_0_out, nnzInfo);
+        activate_0(buffer);
+        fc_1.propagate(buffer.concat_buffer, buffer.fc_1_out);
+        activate_1(buffer);
+        fc_2.propagate(buffer.concat_buffer, buffer.fc_2_out);
+        return output_value(buffer);
+    }
+
+    // Propagates a group of positions that all use this layer stack. Each layer
+    // runs over the whole group before the next one starts, so its weights stay
+    // in cache, and the dense hidden layer shares weight loads between inputs.
+    void propagate_batch(const TransformedFeatureType* const* transformedFeatures,
+                         const NNZInfo<L1>* const*            nnzInfos,
+                         IndexType                            count,
+                         i32*                                 output) const {
+        assert(count <= MaxBatchSize);
+
+        Buffer                                    buffers[MaxBatchSize];
+        const typename decltype(fc_1)::InputType* fc_1_in[MaxBatchSize];
+        typename decltype(fc_1)::OutputType*      fc_1_out[MaxBatchSize];
+
+        for (IndexType n = 0; n < count; ++n)
+        {
+            fc_0.propagate(transformedFeatures[n], buffers[n].fc_0_out, *nnzInfos[n]);
+            activate_0(buffers[n]);
+            fc_1_in[n]  = buffers[n].concat_buffer;
+            fc_1_out[n] = buffers[n].fc_1_out;
+        }
+
+        fc_1.propagate_batch(fc_1_in, fc_1_out, count);
+
+        for (IndexType n = 0; n < count; ++n)
+        {
+            activate_1(buffers[n]);
+            fc_2.propagate(buffers[n].concat_buffer, buffers[n].fc_2_out);
+            output[n] = output_value(buffers[n]);
+        }
+    }
+
+    // Activations of fc_0, written to the first part of the concat buffer
+    void activate_0(Buffer& buffer) const {
 #if defined(USE_AVX2_PAIR_ACTIVATIONS)
         ac_sqr_0.propagate_pair(buffer.fc_0_out, buffer.concat_buffer,
                                 buffer.concat_buffer + FC_0_OUTPUTS);
@@ -124,8 +187,10 @@ struct NetworkArchitecture {
         ac_sqr_0.propagate(buffer.fc_0_out, buffer.concat_buffer);
         ac_0.propagate(buffer.fc_0_out, buffer.concat_buffer + FC_0_OUTPUTS);
 #endif
+    }
 
-        fc_1.propagate(buffer.concat_buffer, buffer.fc_1_out);
+    // Activations of fc_1, appended to the concat buffer
+    void activate_1(Buffer& buffer) const {
 #if defined(USE_AVX2_PAIR_ACTIVATIONS)
         ac_sqr_1.propagate_pair(buffer.fc_1_out, buffer.concat_buffer + FC_0_OUTPUTS * 2,
                                 buffer.concat_buffer + FC_0_OUTPUTS * 2 + FC_1_OUTPUTS);
@@ -133,9 +198,10 @@ struct NetworkArchitecture {
         ac_sqr_1.propagate(buffer.fc_1_out, buffer.concat_buffer + FC_0_OUTPUTS * 2);
         ac_1.propagate(buffer.fc_1_out, buffer.concat_buffer + FC_0_OUTPUTS * 2 + FC_1_OUTPUTS);
 #endif
+    }
 
-        fc_2.propagate(buffer.concat_buffer, buffer.fc_2_out);
-
+    // Adds the skip connection to the output of fc_2 and rescales the result
+    static i32 output_value(const Buffer& buffer) {
         static_assert(FC_0_OUTPUTS >= 2);
         i32 fwdOut = buffer.fc_2_out[0];
         i32 skip_0 = buffer.fc_0_out[FC_0_OUTPUTS - 2] - buffer.fc_0_out[FC_0_OUTPUTS - 1];
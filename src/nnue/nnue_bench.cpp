@@ -0,0 +1,311 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "nnue_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+    #define HAS_CYCLE_COUNTER
+#endif
+
+#include "../misc.h"
+#include "../movegen.h"
+#include "../position.h"
+#include "../types.h"
+#include "network.h"
+#include "nnue_accumulator.h"
+#include "nnue_architecture.h"
+#include "nnue_common.h"
+#include "nnz_helper.h"
+
+namespace Stockfish::Eval::NNUE {
+
+namespace {
+
+// The corpus: each position is followed by up to GamePlies legal moves, picked
+// by a PRNG with a fixed seed, so every build replays exactly the same games.
+constexpr const char* Fens[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+  "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+  "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+  "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+  "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+  "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11"};
+
+constexpr int GamePlies = 64;
+constexpr u64 GameSeed  = 20260101;
+
+enum StageId {
+    REFRESH,
+    INCREMENTAL,
+    THREAT_INDICES,
+    PAIR_INDICES,
+    TRANSFORM,
+    FC_0,
+    AC_0,
+    FC_1,
+    AC_1,
+    FC_2,
+    STAGE_NB
+};
+
+constexpr const char* StageNames[STAGE_NB] = {
+  "Accumulator refresh (cache)", "Accumulator incremental",  "Threat changed indices",
+  "Pawn pair changed indices",   "Feature transform output", "fc_0 (sparse affine)",
+  "fc_0 activations",            "fc_1 (affine)",            "fc_1 activations",
+  "fc_2 (affine)"};
+
+u64 read_cycles() {
+#ifdef HAS_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct Stage {
+    u64 ops = 0, calls = 0, nanos = 0, cycles = 0;
+
+    // Times a single call of f, which performs n operations
+    template<typename F>
+    void time(F&& f, u64 n = 1) {
+        const auto start       = std::chrono::steady_clock::now();
+        const u64  startCycles = read_cycles();
+        f();
+        cycles += read_cycles() - startCycles;
+        nanos += u64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count());
+        ops += n;
+        ++calls;
+    }
+};
+
+// Each sample holds the packed features of one corpus position, the input of
+// the layer stack selected by its piece count
+struct alignas(CacheLineSize) Sample {
+    TransformedFeatureType features[FeatureTransformer::BufferSize];
+    NNZInfo<L1>            nnz;
+    int                    bucket;
+};
+
+}  // namespace
+
+// Accumulator stages are timed per call, with the cost of reading the clocks
+// measured up front and subtracted. Layers are timed over all samples at once.
+std::string stage_benchmark(const Network& network, int rounds) {
+
+    const FeatureTransformer& ft = network.featureTransformer;
+
+    auto stack        = std::make_unique<AccumulatorStack>();
+    auto scratch      = std::make_unique<AccumulatorStack>();
+    auto caches       = std::make_unique<AccumulatorCaches>(network);
+    auto scratchCache = std::make_unique<AccumulatorCaches>(network);
+
+    Stage               stages[STAGE_NB];
+    std::vector<Sample> samples;
+    i64                 checksum = 0;
+
+    Stage overhead;
+    for (int i = 0; i < 100000; ++i)
+        overhead.time([] {});
+
+    for (int round = 0; round < rounds; ++round)
+        for (const char* fen : Fens)
+        {
+            StateListPtr states(new std::deque<StateInfo>(1));
+            Position     pos;
+            PRNG         rng(GameSeed);
+
+            pos.set(fen, false, &states->back());
+            stack->reset();
+            stack->evaluate(pos, ft, *caches);
+
+            for (int ply = 0;; ++ply)
+            {
+                // The accumulator of the current position is computed, pack it
+                Sample sample;
+                sample.bucket = (pos.count<ALL_PIECES>() - 1) / 4;
+
+                stages[TRANSFORM].time([&] {
+                    checksum += ft.transform(pos, *stack, *caches, sample.features, sample.bucket,
+                                             sample.nnz);
+                });
+
+                if (round == 0)
+                    samples.push_back(sample);
+
+                MoveList<LEGAL> moves(pos);
+                if (ply == GamePlies || !moves.size())
+                    break;
+
+                const Move m = *(moves.begin() + rng.rand<u64>() % moves.size());
+                states->emplace_back();
+                Dirties& dirties = stack->push();
+                pos.do_move(m, states->back(), pos.gives_check(m), dirties, nullptr, nullptr);
+
+                for (Color perspective : {WHITE, BLACK})
+                {
+                    const Square                ksq = pos.square<KING>(perspective);
+                    ThreatFeatureSet::IndexList thrRemoved, thrAdded;
+                    PairFeatureSet::IndexList   ppRemoved, ppAdded;
+
+                    stages[THREAT_INDICES].time([&] {
+                        ThreatFeatureSet::append_changed_indices(
+                          perspective, ksq, dirties.dirtyThreats, thrRemoved, thrAdded);
+                    });
+                    stages[PAIR_INDICES].time([&] {
+                        PairFeatureSet::append_changed_indices(
+                          perspective, ksq, dirties.dirtyPawnPairs, ppRemoved, ppAdded);
+                    });
+                    checksum += thrRemoved.size() + thrAdded.size() + ppRemoved.size()
+                              + ppAdded.size();
+                }
+
+                // A refresh of both perspectives from a cache which last saw the
+                // previous position with the same king squares.
+                scratch->reset();
+                stages[REFRESH].time([&] { scratch->evaluate(pos, ft, *scratchCache); }, 2);
+
+                // King moves refresh one perspective and update the other, so
+                // they belong to neither stage and are left untimed.
+                const bool refreshWhite = PSQFeatureSet::requires_refresh(dirties.dirtyPiece, WHITE);
+                const bool refreshBlack = PSQFeatureSet::requires_refresh(dirties.dirtyPiece, BLACK);
+
+                if (!refreshWhite && !refreshBlack)
+                    stages[INCREMENTAL].time([&] { stack->evaluate(pos, ft, *caches); }, 2);
+                else
+                    stack->evaluate(pos, ft, *caches);
+            }
+        }
+
+    for (Stage& stage : stages)
+    {
+        stage.nanos -= std::min(stage.nanos, stage.calls * overhead.nanos / overhead.calls);
+        stage.cycles -= std::min(stage.cycles, stage.calls * overhead.cycles / overhead.calls);
+    }
+
+    std::vector<NetworkArchitecture::Buffer> buffers(samples.size());
+
+    const auto time_layer = [&](StageId id, const auto& propagate) {
+        stages[id].time(
+          [&] {
+              for (int round = 0; round < rounds; ++round)
+                  for (usize i = 0; i < samples.size(); ++i)
+                      propagate(network.network[samples[i].bucket], samples[i], buffers[i]);
+          },
+          u64(rounds) * samples.size());
+    };
+
+    time_layer(FC_0, [](const NetworkArchitecture& arch, const Sample& s, auto& buffer) {
+        arch.fc_0.propagate(s.features, buffer.fc_0_out, s.nnz);
+    });
+    time_layer(AC_0, [](const NetworkArchitecture& arch, const Sample&, auto& buffer) {
+        arch.activate_0(buffer);
+    });
+    time_layer(FC_1, [](const NetworkArchitecture& arch, const Sample&, auto& buffer) {
+        arch.fc_1.propagate(buffer.concat_buffer, buffer.fc_1_out);
+    });
+    time_layer(AC_1, [](const NetworkArchitecture& arch, const Sample&, auto& buffer) {
+        arch.activate_1(buffer);
+    });
+    time_layer(FC_2, [](const NetworkArchitecture& arch, const Sample&, auto& buffer) {
+        arch.fc_2.propagate(buffer.concat_buffer, buffer.fc_2_out);
+    });
+
+    for (const auto& buffer : buffers)
+        checksum += NetworkArchitecture::output_value(buffer);
+
+    std::ostringstream ss;
+
+    ss << "NNUE stage benchmark on ";
+#if defined(ARCH)
+    ss << stringify(ARCH);
+#else
+    ss << "(undefined architecture)";
+#endif
+    ss << ", " << samples.size() << " positions x " << rounds << " rounds\n\n"
+       << std::left << std::setw(30) << "Stage" << std::right << std::setw(12) << "ops"
+       << std::setw(12) << "ns/op" << std::setw(12) << "cycles/op" << '\n';
+
+    ss << std::fixed << std::setprecision(1);
+    for (int id = 0; id < STAGE_NB; ++id)
+    {
+        const Stage& stage = stages[id];
+        const double ops   = double(std::max<u64>(stage.ops, 1));
+
+        ss << std::left << std::setw(30) << StageNames[id] << std::right << std::setw(12)
+           << stage.ops << std::setw(12) << stage.nanos / ops << std::setw(12);
+#ifdef HAS_CYCLE_COUNTER
+        ss << stage.cycles / ops << '\n';
+#else
+        ss << "n/a" << '\n';
+#endif
+    }
+
+    ss << "\nCycles are reference cycles of the time stamp counter, where available."
+       << "\nChecksum: " << checksum;
+
+    return ss.str();
+}
+
+std::vector<std::string> corpus_positions(int games) {
+
+    std::vector<std::string> fens;
+
+    for (const char* fen : Fens)
+        for (int game = 0; game < games; ++game)
+        {
+            StateListPtr states(new std::deque<StateInfo>(1));
+            Position     pos;
+            PRNG         rng(GameSeed + game);
+
+            pos.set(fen, false, &states->back());
+
+            for (int ply = 0;; ++ply)
+            {
+                fens.push_back(pos.fen());
+
+                MoveList<LEGAL> moves(pos);
+                if (ply == GamePlies || !moves.size())
+                    break;
+
+                const Move m = *(moves.begin() + rng.rand<u64>() % moves.size());
+                states->emplace_back();
+                pos.do_move(m, states->back(), nullptr);
+            }
+        }
+
+    return fens;
+}
+
+}  // namespace Stockfish::Eval::NNUE
@@ -0,0 +1,41 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmark of the individual stages of NNUE evaluation
+
+#ifndef NNUE_BENCH_H_INCLUDED
+#define NNUE_BENCH_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+namespace Stockfish::Eval::NNUE {
+
+class Network;
+
+// Replays a fixed corpus of games through the accumulator stack and the layer
+// stacks, and returns a report of the time spent per operation in each stage
+std::string stage_benchmark(const Network& network, int rounds);
+
+// The FENs of the positions of a number of games from each corpus position,
+// played with PRNG-chosen moves. The result is the same in every build.
+std::vector<std::string> corpus_positions(int games);
+
+}  // namespace Stockfish::Eval::NNUE
+
+#endif  // #ifndef NNUE_BENCH_H_INCLUDED
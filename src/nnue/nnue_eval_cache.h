@@ -0,0 +1,97 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Per-thread cache of network outputs
+
+#ifndef NNUE_EVAL_CACHE_H_INCLUDED
+#define NNUE_EVAL_CACHE_H_INCLUDED
+
+#include <cstring>
+#include <tuple>
+
+#include "../memory.h"
+#include "../misc.h"
+#include "../types.h"
+#include "network.h"
+
+namespace Stockfish::Eval::NNUE {
+
+// A direct-mapped table of raw network outputs, owned by a single search thread
+// so that it needs no synchronization and lives on the thread's NUMA node.
+// Positions reached again through transpositions or re-searches skip both the
+// accumulator update and the layer stack. The output of the network does not
+// depend on the fifty-move counter, so entries are keyed by the plain Zobrist
+// key of the position and hold the full key to tell positions apart.
+class EvalCache {
+   public:
+    // Resizes the table to mbSize MiB, which disables it when zero. The thread
+    // that calls this first touches the memory.
+    void resize(usize mbSize) {
+        const usize newCount = mbSize * 1024 * 1024 / sizeof(Entry);
+
+        if (newCount != count)
+        {
+            table.reset();
+            count = newCount;
+            if (count)
+                table = make_unique_aligned<Entry[]>(count);
+        }
+
+        clear();
+    }
+
+    void clear() {
+        if (count)
+            std::memset(static_cast<void*>(table.get()), 0, count * sizeof(Entry));
+    }
+
+    bool enabled() const { return count != 0; }
+
+    bool probe(Key key, NetworkOutput& output) const {
+        const Entry& e = table[mul_hi64(key, count)];
+        if (e.key != key)
+            return false;
+
+        output = {e.psqt, e.positional};
+        return true;
+    }
+
+    void save(Key key, const NetworkOutput& output) {
+        Entry& e     = table[mul_hi64(key, count)];
+        e.key        = key;
+        e.psqt       = std::get<0>(output);
+        e.positional = std::get<1>(output);
+    }
+
+   private:
+    // Four entries per cache line, none of them straddling two lines
+    struct alignas(16) Entry {
+        Key   key;
+        Value psqt;
+        Value positional;
+    };
+
+    static_assert(sizeof(Entry) == 16);
+
+    AlignedPtr<Entry[]> table;
+    usize               count = 0;
+};
+
+}  // namespace Stockfish::Eval::NNUE
+
+#endif  // #ifndef NNUE_EVAL_CACHE_H_INCLUDED
@@ -23,9 +23,11 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <iosfwd>
 #include <iterator>
+#include <memory>
 
 #include "../position.h"
 #include "../types.h"
@@ -95,6 +97,26 @@ class FeatureTransformer {
     // Size of forward propagation buffer
     static constexpr usize BufferSize = OutputDimensions * sizeof(OutputType);
 
+    // Threat and pawn-pair weights, one row of HalfDimensions per feature
+    static constexpr IndexType ThreatWeightRows = ThreatInputDimensions + PairInputDimensions;
+    using ThreatWeightArray = std::array<ThreatWeightType, ThreatWeightRows * HalfDimensions>;
+
+    // A permutation of the L1 neurons, see reorder_neurons()
+    using NeuronOrder = std::array<IndexType, HalfDimensions / 2>;
+
+#ifdef NNUE_THREAT_INT4
+    // With 4-bit weights every group of 2 * ThreatPackLanes consecutive weights of
+    // a row is stored in ThreatPackLanes bytes, the low nibbles holding the first
+    // half of the group and the high nibbles the second half. A single byte load
+    // thus unpacks into two adjacent accumulator registers.
+    #ifdef VECTOR
+    static constexpr IndexType ThreatPackLanes = sizeof(SIMD::vec_t) / 2;
+    #else
+    static constexpr IndexType ThreatPackLanes = 16;
+    #endif
+    static_assert(HalfDimensions % (2 * ThreatPackLanes) == 0);
+#endif
+
     // Store the order by which 128-bit blocks of a 1024-bit data must
     // be permuted so that calling packus on adjacent vectors of 16-bit
     // integers loaded from the data results in the pre-permutation order
@@ -128,31 +150,190 @@ class FeatureTransformer {
         return hash;
     }
 
-    // Hash value embedded in the evaluation file
-    static constexpr u32 get_hash_value() {
+    // Hash value of the portable format with 8-bit threat and pawn-pair weights
+    static constexpr u32 get_int8_hash_value() {
         return combine_hash(
                  {ThreatFeatureSet::HashValue, PairFeatureSet::HashValue, PSQFeatureSet::HashValue})
              ^ (OutputDimensions * 2);
     }
 
+    // Hash value embedded in the evaluation file. Files with 4-bit threat and
+    // pawn-pair weights have their own hash, so builds with 8-bit weights reject
+    // them while builds with 4-bit weights read both variants.
+    static constexpr u32 get_hash_value() {
+#ifdef NNUE_THREAT_INT4
+        return get_int8_hash_value() ^ 0x34544E49;
+#else
+        return get_int8_hash_value();
+#endif
+    }
+
     void permute_weights() {
         permute<16>(biases, PackusEpi16Order);
         permute<16>(weights, PackusEpi16Order);
 
+#ifndef NNUE_THREAT_INT4
         permute<8>(threatAndPpWeights, PackusEpi16Order);
+#endif
     }
 
     void unpermute_weights() {
         permute<16>(biases, InversePackusEpi16Order);
         permute<16>(weights, InversePackusEpi16Order);
+#ifndef NNUE_THREAT_INT4
         permute<8>(threatAndPpWeights, InversePackusEpi16Order);
+#endif
     }
 
-    auto threatWeights() { return threatAndPpWeights.data(); }
-    auto threatWeights() const { return threatAndPpWeights.data(); }
-    auto ppWeights() { return &threatAndPpWeights[ThreatFeatureSet::Dimensions * HalfDimensions]; }
-    auto ppWeights() const {
-        return &threatAndPpWeights[ThreatFeatureSet::Dimensions * HalfDimensions];
+#ifdef NNUE_THREAT_INT4
+    // Quantize 8-bit threat and pawn-pair weights to 4 bits with one scale per
+    // row, replacing each weight by its 4-bit value. Used when an int4 build
+    // loads a file with 8-bit weights.
+    void quantize_threat_weights(ThreatWeightArray& weightsToQuantize) {
+        for (IndexType index = 0; index < ThreatWeightRows; ++index)
+        {
+            ThreatWeightType* row = &weightsToQuantize[usize(index) * HalfDimensions];
+
+            int maxAbs = 0;
+            for (IndexType j = 0; j < HalfDimensions; ++j)
+                maxAbs = std::max(maxAbs, std::abs(int(row[j])));
+
+            const int scale          = std::max((maxAbs + 6) / 7, 1);
+            threatAndPpScales[index] = i16(scale);
+
+            for (IndexType j = 0; j < HalfDimensions; ++j)
+            {
+                const int w = row[j];
+                const int q = (w + (w < 0 ? -scale : scale) / 2) / scale;
+                row[j]      = ThreatWeightType(std::clamp(q, -7, 7));
+            }
+        }
+    }
+
+    // Store the (permuted) 4-bit values in the interleaved layout
+    void pack_threat_weights(const ThreatWeightArray& nibbles) {
+        for (IndexType index = 0; index < ThreatWeightRows; ++index)
+            for (IndexType j = 0; j < HalfDimensions; ++j)
+            {
+                const u8 q    = u8(nibbles[usize(index) * HalfDimensions + j] & 0x0F);
+                u8&      byte = threatAndPpWeights[packed_index(index, j)];
+
+                byte = packed_high(j) ? u8((byte & 0x0F) | (q << 4)) : u8((byte & 0xF0) | q);
+            }
+    }
+
+    void unpack_threat_weights(ThreatWeightArray& nibbles) const {
+        for (IndexType index = 0; index < ThreatWeightRows; ++index)
+            for (IndexType j = 0; j < HalfDimensions; ++j)
+                nibbles[usize(index) * HalfDimensions + j] =
+                  ThreatWeightType(threat_nibble(index, j));
+    }
+
+    // Index of the byte holding the j-th weight of the given row, in its high
+    // nibble if the weight is in the second half of its group
+    static constexpr usize packed_index(IndexType index, IndexType j) {
+        const IndexType lane = j % (2 * ThreatPackLanes);
+        return (usize(index) * HalfDimensions + j - lane) / 2 + lane % ThreatPackLanes;
+    }
+
+    static constexpr bool packed_high(IndexType j) {
+        return j % (2 * ThreatPackLanes) >= ThreatPackLanes;
+    }
+
+    int threat_nibble(IndexType index, IndexType j) const {
+        const u8 byte = threatAndPpWeights[packed_index(index, j)];
+        return packed_high(j) ? i8(byte) >> 4 : i8(u8(byte << 4)) >> 4;
+    }
+
+    // In files with 4-bit weights each threat and pawn-pair row is stored as its
+    // 16-bit scale followed by HalfDimensions / 2 bytes, in unpermuted order, the
+    // low nibble of a byte holding the even weight and the high nibble the odd one.
+    static void read_packed_rows(std::istream&     stream,
+                                 ThreatWeightType* nibbles,
+                                 i16*              scales,
+                                 IndexType         count) {
+        std::array<u8, HalfDimensions / 2> bytes;
+
+        for (IndexType index = 0; index < count; ++index, nibbles += HalfDimensions)
+        {
+            scales[index] = read_little_endian<i16>(stream);
+            stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+            for (IndexType k = 0; k < HalfDimensions / 2; ++k)
+            {
+                nibbles[2 * k]     = ThreatWeightType(i8(u8(bytes[k] << 4)) >> 4);
+                nibbles[2 * k + 1] = ThreatWeightType(i8(bytes[k]) >> 4);
+            }
+        }
+    }
+
+    static void write_packed_rows(std::ostream&           stream,
+                                  const ThreatWeightType* nibbles,
+                                  const i16*              scales,
+                                  IndexType               count) {
+        std::array<u8, HalfDimensions / 2> bytes;
+
+        for (IndexType index = 0; index < count; ++index, nibbles += HalfDimensions)
+        {
+            for (IndexType k = 0; k < HalfDimensions / 2; ++k)
+                bytes[k] = u8((nibbles[2 * k] & 0x0F) | ((nibbles[2 * k + 1] & 0x0F) << 4));
+
+            write_little_endian<i16>(stream, scales[index]);
+            stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        }
+    }
+#endif
+
+    // Moves L1 neuron order[i] to position i. A neuron is the product of two
+    // accumulator entries, j and j + HalfDimensions / 2, which move together.
+    void reorder_neurons(const NeuronOrder& order) {
+        unpermute_weights();
+
+#ifdef NNUE_THREAT_INT4
+        // Reorder the 4-bit values, the per-row scales do not change
+        auto unpacked = std::make_unique<ThreatWeightArray>();
+        unpack_threat_weights(*unpacked);
+        permute<8>(*unpacked, InversePackusEpi16Order);
+        ThreatWeightType* threats = unpacked->data();
+#else
+        ThreatWeightType* threats = threatAndPpWeights.data();
+#endif
+
+        reorder_columns(biases.data(), 1, order);
+        reorder_columns(weights.data(), PSQFeatureSet::Dimensions, order);
+        reorder_columns(threats, ThreatWeightRows, order);
+
+        permute_weights();
+
+#ifdef NNUE_THREAT_INT4
+        permute<8>(*unpacked, PackusEpi16Order);
+        pack_threat_weights(*unpacked);
+#endif
+    }
+
+    template<typename T>
+    static void reorder_columns(T* rows, usize count, const NeuronOrder& order) {
+        std::array<T, HalfDimensions> row;
+
+        for (T* r = rows; r != rows + count * HalfDimensions; r += HalfDimensions)
+        {
+            std::copy(r, r + HalfDimensions, row.begin());
+
+            for (IndexType i = 0; i < HalfDimensions / 2; ++i)
+            {
+                r[i]                      = row[order[i]];
+                r[i + HalfDimensions / 2] = row[order[i] + HalfDimensions / 2];
+            }
+        }
+    }
+
+    // The j-th weight of a threat or pawn-pair feature, in permuted order
+    i16 threat_weight(IndexType index, IndexType j) const {
+#ifdef NNUE_THREAT_INT4
+        return i16(threat_nibble(index, j) * threatAndPpScales[index]);
+#else
+        return threatAndPpWeights[usize(index) * HalfDimensions + j];
+#endif
     }
 
     auto threatPsqtWeights() { return threatAndPpPsqtWeights.data(); }
@@ -165,15 +346,30 @@ class FeatureTransformer {
     }
 
 
-    // Read network parameters
-    bool read_parameters(std::istream& stream) {
+    // Read network parameters. A build with 4-bit threat weights also reads the
+    // 8-bit variant, see Network::read_parameters(), quantizing it on load.
+    bool read_parameters(std::istream& stream, [[maybe_unused]] bool int8Threats = false) {
         read_leb_128(stream, biases);
 
-        read_little_endian<ThreatWeightType>(stream, threatWeights(),
-                                             ThreatInputDimensions * HalfDimensions);
+#ifdef NNUE_THREAT_INT4
+        auto unpacked    = std::make_unique<ThreatWeightArray>();
+        auto readThreats = [&](IndexType first, IndexType count) {
+            ThreatWeightType* rows = &(*unpacked)[usize(first) * HalfDimensions];
+            if (int8Threats)
+                read_little_endian<ThreatWeightType>(stream, rows, count * HalfDimensions);
+            else
+                read_packed_rows(stream, rows, &threatAndPpScales[first], count);
+        };
+#else
+        auto readThreats = [&](IndexType first, IndexType count) {
+            read_little_endian<ThreatWeightType>(
+              stream, &threatAndPpWeights[usize(first) * HalfDimensions], count * HalfDimensions);
+        };
+#endif
+
+        readThreats(0, ThreatInputDimensions);
         read_leb_128(stream, threatPsqtWeights(), ThreatFeatureSet::Dimensions * PSQTBuckets);
-        read_little_endian<ThreatWeightType>(stream, ppWeights(),
-                                             PairInputDimensions * HalfDimensions);
+        readThreats(ThreatInputDimensions, PairInputDimensions);
         read_leb_128(stream, ppPsqtWeights(), PairFeatureSet::Dimensions * PSQTBuckets);
 
         read_leb_128(stream, weights);
@@ -181,24 +377,47 @@ class FeatureTransformer {
 
         permute_weights();
 
+#ifdef NNUE_THREAT_INT4
+        if (int8Threats)
+            quantize_threat_weights(*unpacked);
+
+        permute<8>(*unpacked, PackusEpi16Order);
+        pack_threat_weights(*unpacked);
+#endif
+
         return !stream.fail();
     }
 
-    // Write network parameters
+    // Write network parameters. A build with 4-bit threat weights writes only the
+    // 4-bit variant, as the 8-bit weights are not recoverable.
     bool write_parameters(std::ostream& stream) const {
         std::unique_ptr<FeatureTransformer> copy = std::make_unique<FeatureTransformer>(*this);
 
         copy->unpermute_weights();
 
-        write_leb_128<BiasType>(stream, copy->biases);
+#ifdef NNUE_THREAT_INT4
+        auto unpacked = std::make_unique<ThreatWeightArray>();
+        unpack_threat_weights(*unpacked);
+        permute<8>(*unpacked, InversePackusEpi16Order);
+
+        auto writeThreats = [&](IndexType first, IndexType count) {
+            write_packed_rows(stream, &(*unpacked)[usize(first) * HalfDimensions],
+                              &threatAndPpScales[first], count);
+        };
+#else
+        auto writeThreats = [&](IndexType first, IndexType count) {
+            write_little_endian<ThreatWeightType>(
+              stream, &copy->threatAndPpWeights[usize(first) * HalfDimensions],
+              count * HalfDimensions);
+        };
+#endif
 
+        write_leb_128<BiasType>(stream, copy->biases);
 
-        write_little_endian<ThreatWeightType>(stream, copy->threatWeights(),
-                                              ThreatInputDimensions * HalfDimensions);
+        writeThreats(0, ThreatInputDimensions);
         write_leb_128<PSQTWeightType>(stream, copy->threatPsqtWeights(),
                                       ThreatFeatureSet::Dimensions * PSQTBuckets);
-        write_little_endian<ThreatWeightType>(stream, copy->ppWeights(),
-                                              PairInputDimensions * HalfDimensions);
+        writeThreats(ThreatInputDimensions, PairInputDimensions);
         write_leb_128<PSQTWeightType>(stream, copy->ppPsqtWeights(),
                                       PairFeatureSet::Dimensions * PSQTBuckets);
 
@@ -216,6 +435,9 @@ class FeatureTransformer {
         hash_combine(h, get_raw_data_hash(psqtWeights));
 
         hash_combine(h, get_raw_data_hash(threatAndPpWeights));
+#ifdef NNUE_THREAT_INT4
+        hash_combine(h, get_raw_data_hash(threatAndPpScales));
+#endif
         hash_combine(h, get_raw_data_hash(threatAndPpPsqtWeights));
 
         hash_combine(h, get_hash_value());
@@ -432,9 +654,12 @@ class FeatureTransformer {
     // The first pawn-pair feature is at index ThreatFeatureSet::Dimensions.
     static_assert(PairFeatureSet::IndexBase == ThreatFeatureSet::Dimensions);
 
-    alignas(CacheLineSize) std::array<ThreatWeightType,
-                                      (ThreatFeatureSet::Dimensions + PairFeatureSet::Dimensions)
-                                        * HalfDimensions> threatAndPpWeights;
+#ifdef NNUE_THREAT_INT4
+    alignas(CacheLineSize) std::array<u8, ThreatWeightRows * HalfDimensions / 2> threatAndPpWeights;
+    alignas(CacheLineSize) std::array<i16, ThreatWeightRows> threatAndPpScales;
+#else
+    alignas(CacheLineSize) ThreatWeightArray threatAndPpWeights;
+#endif
     alignas(CacheLineSize)
       std::array<PSQTWeightType, PSQTBuckets * PSQFeatureSet::Dimensions> psqtWeights;
     // As above
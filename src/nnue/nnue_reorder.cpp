@@ -0,0 +1,221 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "nnue_reorder.h"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <memory>
+#include <numeric>
+#include <sstream>
+
+#include "../bitboard.h"
+#include "../position.h"
+#include "../types.h"
+#include "network.h"
+#include "nnue_accumulator.h"
+#include "nnue_architecture.h"
+#include "nnue_common.h"
+#include "nnue_feature_transformer.h"
+#include "nnz_helper.h"
+
+namespace Stockfish::Eval::NNUE {
+
+namespace {
+
+// Neurons per perspective, each is one byte of the fc_0 input
+constexpr IndexType Neurons = FeatureTransformer::OutputDimensions / 2;
+
+// Bytes per input chunk of the sparse fc_0 kernels, see AffineTransformSparseInput
+constexpr IndexType ChunkNeurons = 4;
+
+constexpr usize MaxPositions = 1 << 15;
+
+static_assert(Neurons % ChunkNeurons == 0);
+
+// Every position yields two samples, the neurons of either perspective
+struct Statistics {
+    std::vector<NetworkOutput> outputs;
+    u64                        nonZeroChunks = 0;
+    usize                      skipped       = 0;
+    usize                      words         = 0;
+
+    // For each neuron, a bitset of the samples in which it is non-zero
+    std::vector<u64> active;
+
+    const u64* neuron(IndexType n) const { return &active[n * words]; }
+};
+
+// Evaluates each position from scratch, keeping the output of the network, the
+// number of non-zero fc_0 input chunks and the activity of every neuron
+Statistics sample(const Network&                  network,
+                  const FeatureTransformer&       ft,
+                  const std::vector<std::string>& fens,
+                  bool                            chess960) {
+
+    auto stack  = std::make_unique<AccumulatorStack>();
+    auto caches = std::make_unique<AccumulatorCaches>(network);
+
+    alignas(CacheLineSize) TransformedFeatureType features[FeatureTransformer::BufferSize];
+
+    Statistics stats;
+    stats.words = (2 * std::min(fens.size(), MaxPositions) + 63) / 64;
+    stats.active.assign(Neurons * stats.words, 0);
+
+    for (const std::string& fen : fens)
+    {
+        if (stats.outputs.size() == MaxPositions)
+            break;
+
+        StateInfo st;
+        Position  pos;
+        if (pos.set(fen, chess960, &st))
+        {
+            ++stats.skipped;
+            continue;
+        }
+
+        const usize s = 2 * stats.outputs.size();
+        NNZInfo<L1> nnz{};
+
+        stack->reset();
+        stats.outputs.push_back(network.evaluate(pos, *stack, *caches));
+        ft.transform(pos, *stack, *caches, features, (pos.count<ALL_PIECES>() - 1) / 4, nnz);
+
+        for (IndexType p = 0; p < 2; ++p)
+            for (IndexType n = 0; n < Neurons; ++n)
+                if (features[p * Neurons + n])
+                    stats.active[n * stats.words + (s + p) / 64] |= 1ULL << ((s + p) % 64);
+
+        for (IndexType c = 0; c < 2 * Neurons; c += ChunkNeurons)
+            stats.nonZeroChunks += std::any_of(features + c, features + c + ChunkNeurons,
+                                               [](TransformedFeatureType v) { return v != 0; });
+    }
+
+    return stats;
+}
+
+// Fills the chunks one at a time. A chunk is seeded with the most active neuron
+// left, then grows by the neuron which is active in the most samples where the
+// chunk already is, as those cost nothing extra. Neurons that are never active
+// are left to the end and share chunks which are always zero.
+FeatureTransformer::NeuronOrder greedy_order(const Statistics& stats) {
+
+    std::array<usize, Neurons> activity;
+    for (IndexType n = 0; n < Neurons; ++n)
+        activity[n] = std::accumulate(stats.neuron(n), stats.neuron(n) + stats.words, usize(0),
+                                      [](usize sum, u64 bits) { return sum + popcount(bits); });
+
+    std::vector<IndexType> left(Neurons);
+    std::iota(left.begin(), left.end(), IndexType(0));
+    std::stable_sort(left.begin(), left.end(),
+                     [&](IndexType a, IndexType b) { return activity[a] > activity[b]; });
+
+    FeatureTransformer::NeuronOrder order;
+    std::vector<u64>                chunk(stats.words);
+    IndexType                       next = 0;
+
+    while (!left.empty())
+    {
+        usize pick = 0;
+
+        for (IndexType k = 0; k < ChunkNeurons; ++k)
+        {
+            if (k)
+            {
+                usize bestOverlap = 0;
+                pick              = 0;
+
+                for (usize i = 0; i < left.size(); ++i)
+                {
+                    const u64* bits    = stats.neuron(left[i]);
+                    usize      overlap = 0;
+
+                    for (usize w = 0; w < stats.words; ++w)
+                        overlap += popcount(chunk[w] & bits[w]);
+
+                    if (overlap > bestOverlap)
+                    {
+                        bestOverlap = overlap;
+                        pick        = i;
+                    }
+                }
+            }
+
+            const u64* bits = stats.neuron(left[pick]);
+            for (usize w = 0; w < stats.words; ++w)
+                chunk[w] = k ? chunk[w] | bits[w] : bits[w];
+
+            order[next++] = left[pick];
+            left.erase(left.begin() + pick);
+        }
+    }
+
+    return order;
+}
+
+}  // namespace
+
+std::optional<std::string> reorder_neurons(Network&                        network,
+                                           const std::vector<std::string>& fens,
+                                           bool                            chess960,
+                                           std::string&                    report) {
+
+    const Statistics before = sample(network, network.featureTransformer, fens, chess960);
+    if (before.outputs.empty())
+        return "No valid positions to sample";
+
+    const FeatureTransformer::NeuronOrder order = greedy_order(before);
+
+    std::array<IndexType, L1> inputs;
+    for (IndexType i = 0; i < Neurons; ++i)
+    {
+        inputs[i]           = order[i];
+        inputs[i + Neurons] = order[i] + Neurons;
+    }
+
+    network.featureTransformer.reorder_neurons(order);
+    for (auto& arch : network.network)
+        arch.fc_0.reorder_inputs(inputs);
+    network.hash_content();
+
+    const Statistics after = sample(network, network.featureTransformer, fens, chess960);
+    if (after.outputs != before.outputs)
+        return "The reordered network does not reproduce the original evaluations";
+
+    IndexType dead = 0;
+    for (IndexType n = 0; n < Neurons; ++n)
+        dead += std::none_of(before.neuron(n), before.neuron(n) + before.words,
+                             [](u64 bits) { return bits != 0; });
+
+    const double positions = double(before.outputs.size());
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1) << "info string Sampled " << before.outputs.size()
+       << " positions (" << before.skipped << " skipped), " << dead << " of " << Neurons
+       << " neurons never active"
+       << "\ninfo string Non-zero fc_0 input chunks per position: "
+       << before.nonZeroChunks / positions << " before, " << after.nonZeroChunks / positions
+       << " after, of " << 2 * Neurons / ChunkNeurons;
+
+    report = ss.str();
+    return std::nullopt;
+}
+
+}  // namespace Stockfish::Eval::NNUE
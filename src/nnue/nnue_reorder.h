@@ -0,0 +1,43 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Reordering of the L1 neurons of a network for sparser fc_0 input
+
+#ifndef NNUE_REORDER_H_INCLUDED
+#define NNUE_REORDER_H_INCLUDED
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Stockfish::Eval::NNUE {
+
+class Network;
+
+// Permutes the L1 neurons of the network so that neurons which are active in
+// the same positions share the input chunks that fc_0 skips when all zero.
+// Activity is sampled over the given positions. The reordered network must
+// evaluate every sample exactly as before, otherwise an error is returned.
+std::optional<std::string> reorder_neurons(Network&                        network,
+                                           const std::vector<std::string>& fens,
+                                           bool                            chess960,
+                                           std::string&                    report);
+
+}  // namespace Stockfish::Eval::NNUE
+
+#endif  // #ifndef NNUE_REORDER_H_INCLUDED
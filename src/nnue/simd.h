@@ -75,6 +75,8 @@ using psqt_vec_t = __m256i;
     #define vec_max_16(a, b) _mm512_max_epi16(a, b)
     #define vec_min_16(a, b) _mm512_min_epi16(a, b)
     #define vec_slli_16(a, b) _mm512_slli_epi16(a, b)
+    #define vec_srai_16(a, b) _mm512_srai_epi16(a, b)
+    #define vec_mullo_16(a, b) _mm512_mullo_epi16(a, b)
     // Inverse permuted at load time
     #define vec_packus_16(a, b) _mm512_packus_epi16(a, b)
     #define vec_load_psqt(a) _mm256_load_si256(a)
@@ -103,6 +105,8 @@ using psqt_vec_t = __m256i;
     #define vec_max_16(a, b) _mm256_max_epi16(a, b)
     #define vec_min_16(a, b) _mm256_min_epi16(a, b)
     #define vec_slli_16(a, b) _mm256_slli_epi16(a, b)
+    #define vec_srai_16(a, b) _mm256_srai_epi16(a, b)
+    #define vec_mullo_16(a, b) _mm256_mullo_epi16(a, b)
     // Inverse permuted at load time
     #define vec_packus_16(a, b) _mm256_packus_epi16(a, b)
     #define vec_load_psqt(a) _mm256_load_si256(a)
@@ -131,6 +135,8 @@ using psqt_vec_t = __m128i;
     #define vec_max_16(a, b) _mm_max_epi16(a, b)
     #define vec_min_16(a, b) _mm_min_epi16(a, b)
     #define vec_slli_16(a, b) _mm_slli_epi16(a, b)
+    #define vec_srai_16(a, b) _mm_srai_epi16(a, b)
+    #define vec_mullo_16(a, b) _mm_mullo_epi16(a, b)
     #define vec_packus_16(a, b) _mm_packus_epi16(a, b)
     #define vec_load_psqt(a) (*(a))
     #define vec_store_psqt(a, b) *(a) = (b)
@@ -187,6 +193,8 @@ using psqt_vec_t __attribute__((may_alias)) = int32x4_t;
     #define vec_max_16(a, b) vmaxq_s16(a, b)
     #define vec_min_16(a, b) vminq_s16(a, b)
     #define vec_slli_16(a, b) vshlq_s16(a, vec_set_16(b))
+    #define vec_srai_16(a, b) vshrq_n_s16(a, b)
+    #define vec_mullo_16(a, b) vmulq_s16(a, b)
     #define vec_packus_16(a, b) reinterpret_cast<vec_t>(vcombine_u8(vqmovun_s16(a), vqmovun_s16(b)))
     #define vec_load_psqt(a) (*(a))
     #define vec_store_psqt(a, b) *(a) = (b)
@@ -240,6 +248,8 @@ inline __m256i lasx_packus_32(__m256i a, __m256i b) {
     #define vec_max_16(a, b) __lasx_xvmax_h(a, b)
     #define vec_min_16(a, b) __lasx_xvmin_h(a, b)
     #define vec_slli_16(a, b) __lasx_xvslli_h(a, b)
+    #define vec_srai_16(a, b) __lasx_xvsrai_h(a, b)
+    #define vec_mullo_16(a, b) __lasx_xvmul_h(a, b)
     // Inverse permuted at load time
     #define vec_packus_16(a, b) lasx_packus_16(a, b)
     #define vec_load_psqt(a) lasx_load256(a)
@@ -309,6 +319,8 @@ inline __m128i lsx_packus_32(__m128i a, __m128i b) {
     #define vec_max_16(a, b) __lsx_vmax_h(a, b)
     #define vec_min_16(a, b) __lsx_vmin_h(a, b)
     #define vec_slli_16(a, b) __lsx_vslli_h(a, b)
+    #define vec_srai_16(a, b) __lsx_vsrai_h(a, b)
+    #define vec_mullo_16(a, b) __lsx_vmul_h(a, b)
     // Inverse permuted at load time
     #define vec_packus_16(a, b) lsx_packus_16(a, b)
     #define vec_load_psqt(a) (*(a))
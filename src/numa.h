@@ -709,6 +709,43 @@ class NumaConfig {
 
     bool requires_memory_replication() const { return customAffinity || nodes.size() > 1; }
 
+    // Returns the system NUMA nodes that the processors of node n belong to. Memory
+    // placement policies operate on these, and for custom or L3-aware configurations
+    // they differ from n. Returns an empty set if they cannot be determined.
+    std::set<usize> system_numa_nodes(NumaIndex n) const {
+        assert(n < nodes.size());
+
+        std::set<usize> systemNodes;
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+        auto nodeIdsStr = read_file_to_string("/sys/devices/system/node/online");
+        if (!nodeIdsStr.has_value())
+            return systemNodes;
+
+        remove_whitespace(*nodeIdsStr);
+        for (usize sysNode : indices_from_shortened_string(*nodeIdsStr))
+        {
+            std::string path =
+              std::string("/sys/devices/system/node/node") + std::to_string(sysNode) + "/cpulist";
+            auto cpuIdsStr = read_file_to_string(path);
+            if (!cpuIdsStr.has_value())
+                continue;
+
+            remove_whitespace(*cpuIdsStr);
+            for (usize c : indices_from_shortened_string(*cpuIdsStr))
+                if (nodes[n].count(c))
+                {
+                    systemNodes.insert(sysNode);
+                    break;
+                }
+        }
+
+#endif
+
+        return systemNodes;
+    }
+
     std::string to_string() const {
         std::string str;
 
@@ -1505,12 +1542,22 @@ class LazyNumaReplicated: public NumaReplicatedBase {
     }
 };
 
-// Utilizes shared memory.
+// Utilizes shared memory. Every source is replicated into a generation of its
+// own, which readers may pin. Readers that pinned a generation keep it when a
+// new source is replicated, its replicas and shared memory segments are only
+// released with the last pin.
 template<typename T>
 class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
    public:
     using ReplicatorFuncType = std::function<T(const T&)>;
 
+    struct Generation {
+        std::vector<SystemWideSharedConstant<T>> instances;
+        u64                                      version = 0;
+    };
+
+    using Pin = std::shared_ptr<Generation>;
+
     LazyNumaReplicatedSystemWide(NumaReplicationContext& ctx) :
         NumaReplicatedBase(ctx) {
         prepare_replicate_from(std::make_unique<T>());
@@ -1524,12 +1571,14 @@ class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
     LazyNumaReplicatedSystemWide(const LazyNumaReplicatedSystemWide&) = delete;
     LazyNumaReplicatedSystemWide(LazyNumaReplicatedSystemWide&& other) noexcept :
         NumaReplicatedBase(std::move(other)),
-        instances(std::exchange(other.instances, {})) {}
+        generation(std::exchange(other.generation, {})),
+        latestVersion(other.latestVersion.load()) {}
 
     LazyNumaReplicatedSystemWide& operator=(const LazyNumaReplicatedSystemWide&) = delete;
     LazyNumaReplicatedSystemWide& operator=(LazyNumaReplicatedSystemWide&& other) noexcept {
         NumaReplicatedBase::operator=(*this, std::move(other));
-        instances = std::exchange(other.instances, {});
+        generation = std::exchange(other.generation, {});
+        latestVersion.store(other.latestVersion.load());
 
         return *this;
     }
@@ -1542,23 +1591,34 @@ class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
 
     ~LazyNumaReplicatedSystemWide() override = default;
 
-    const T& operator[](NumaReplicatedAccessToken token) const {
-        assert(token.get_numa_index() < instances.size());
-        ensure_present(token.get_numa_index());
-        return *(instances[token.get_numa_index()]);
+    const T& operator[](NumaReplicatedAccessToken token) const { return get(generation, token); }
+
+    const T& operator*() const { return *(generation->instances[0]); }
+
+    const T* operator->() const { return &*generation->instances[0]; }
+
+    // Returns the latest generation, which stays valid while the pin is held
+    Pin pin() const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return generation;
     }
 
-    const T& operator*() const { return *(instances[0]); }
+    // Cheap enough to poll, changes whenever a new source has been replicated
+    u64 version() const { return latestVersion.load(std::memory_order_acquire); }
 
-    const T* operator->() const { return &*instances[0]; }
+    const T& get(const Pin& pinned, NumaReplicatedAccessToken token) const {
+        assert(token.get_numa_index() < pinned->instances.size());
+        ensure_present(*pinned, token.get_numa_index());
+        return *(pinned->instances[token.get_numa_index()]);
+    }
 
     std::vector<std::pair<SystemWideSharedConstantAllocationStatus, std::optional<std::string>>>
     get_status_and_errors() const {
         std::vector<std::pair<SystemWideSharedConstantAllocationStatus, std::optional<std::string>>>
           status;
-        status.reserve(instances.size());
+        status.reserve(generation->instances.size());
 
-        for (const auto& instance : instances)
+        for (const auto& instance : generation->instances)
         {
             status.emplace_back(instance.get_status(), instance.get_error_message());
         }
@@ -1568,7 +1628,7 @@ class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
 
     template<typename FuncT>
     void modify_and_replicate(FuncT&& f) {
-        auto source = std::make_unique<T>(*instances[0]);
+        auto source = std::make_unique<T>(*generation->instances[0]);
         std::forward<FuncT>(f)(*source);
         prepare_replicate_from(std::move(source));
     }
@@ -1576,13 +1636,14 @@ class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
     void on_numa_config_changed() override {
         // Use the first one as the source. It doesn't matter which one we use,
         // because they all must be identical, but the first one is guaranteed to exist.
-        auto source = std::make_unique<T>(*instances[0]);
+        auto source = std::make_unique<T>(*generation->instances[0]);
         prepare_replicate_from(std::move(source));
     }
 
    private:
-    mutable std::vector<SystemWideSharedConstant<T>> instances;
-    mutable std::mutex                               mutex;
+    Pin                generation;
+    std::atomic<u64>   latestVersion{0};
+    mutable std::mutex mutex;
 
     usize get_discriminator(NumaIndex idx) const {
         const NumaConfig& cfg     = get_numa_config();
@@ -1594,27 +1655,27 @@ class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
         return static_cast<usize>(hash_string(s));
     }
 
-    void ensure_present(NumaIndex idx) const {
-        assert(idx < instances.size());
+    void ensure_present(Generation& g, NumaIndex idx) const {
+        assert(idx < g.instances.size());
 
-        if (instances[idx] != nullptr)
+        if (g.instances[idx] != nullptr)
             return;
 
         assert(idx != 0);
 
         std::unique_lock<std::mutex> lock(mutex);
         // Check again for races.
-        if (instances[idx] != nullptr)
+        if (g.instances[idx] != nullptr)
             return;
 
         const NumaConfig& cfg = get_numa_config();
-        cfg.execute_on_numa_node(idx, [this, idx]() {
-            instances[idx] = SystemWideSharedConstant<T>(*instances[0], get_discriminator(idx));
+        cfg.execute_on_numa_node(idx, [this, &g, idx]() {
+            g.instances[idx] = SystemWideSharedConstant<T>(*g.instances[0], get_discriminator(idx));
         });
     }
 
     void prepare_replicate_from(std::unique_ptr<T>&& source) {
-        instances.clear();
+        auto next = std::make_shared<Generation>();
 
         const NumaConfig& cfg = get_numa_config();
         // We just need to make sure the first instance is there.
@@ -1625,17 +1686,28 @@ class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
         {
             assert(cfg.num_numa_nodes() > 0);
 
-            cfg.execute_on_numa_node(0, [this, &source]() {
-                instances.emplace_back(SystemWideSharedConstant<T>(*source, get_discriminator(0)));
+            cfg.execute_on_numa_node(0, [this, &source, &next]() {
+                next->instances.emplace_back(
+                  SystemWideSharedConstant<T>(*source, get_discriminator(0)));
             });
 
             // Prepare others for lazy init.
-            instances.resize(cfg.num_numa_nodes());
+            next->instances.resize(cfg.num_numa_nodes());
         }
         else
         {
             assert(cfg.num_numa_nodes() == 1);
-            instances.emplace_back(SystemWideSharedConstant<T>(*source, get_discriminator(0)));
+            next->instances.emplace_back(SystemWideSharedConstant<T>(*source, get_discriminator(0)));
+        }
+
+        // Readers may pin concurrently, the replaced generation is released
+        // outside of the lock, unless it is still pinned.
+        Pin previous;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            next->version = latestVersion.load(std::memory_order_relaxed) + 1;
+            previous      = std::exchange(generation, std::move(next));
+            latestVersion.store(generation->version, std::memory_order_release);
         }
     }
 };
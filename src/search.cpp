@@ -72,6 +72,36 @@ constexpr u64 NODES_LIMIT_OUTPUT = 10'000'000;
 constexpr int SEARCHEDLIST_CAPACITY = 32;
 using SearchedList                  = ValueList<Move, SEARCHEDLIST_CAPACITY>;
 
+// Software pipelined TT prefetching for the captures of qsearch and ProbCut. The
+// first call prefetches the children of the next few moves as one batch, later
+// calls only the move entering the window, so that the TT latency of each child
+// overlaps with the search of its older siblings.
+class TTPrefetcher {
+   public:
+    TTPrefetcher(const TranspositionTable& t, const Position& p) :
+        tt(t),
+        pos(p) {}
+
+    void operator()(const MovePicker& mp) {
+        Move moves[Distance];
+        Key  keys[Distance];
+        int  n = mp.upcoming_moves(moves, Distance), k = 0;
+
+        for (int i = primed ? Distance - 1 : 0; i < n; ++i)
+            keys[k++] = pos.prefetch_key(moves[i]);
+
+        tt.prefetch_batch(keys, k);
+        primed = n > 0;
+    }
+
+   private:
+    static constexpr int Distance = 4;
+
+    const TranspositionTable& tt;
+    const Position&           pos;
+    bool                      primed = false;
+};
+
 // (*Scalers):
 // The values with Scaler asterisks have proven non-linear scaling.
 // They are optimized to time controls of 180 + 1.8 and longer,
@@ -179,6 +209,8 @@ Search::Worker::Worker(SharedState&                    sharedState,
     tt(sharedState.tt),
     network(sharedState.network),
     refreshTable(network[token]) {
+    evalCache.resize(usize(options["EvalCache"]));
+    refreshTable.store.resize(usize(options["AccumulatorStore"]));
     clear();
 }
 
@@ -240,7 +272,19 @@ void Search::Worker::start_searching() {
     Skill   skill =
       Skill(options["Skill Level"], options["UCI_LimitStrength"] ? int(options["UCI_Elo"]) : 0);
 
-    if (!limits.depth && !skill.enabled())
+    // With parallel MultiPV, the deepest completed result of each line is merged
+    // in the main thread. The lines may come from different depths, so they are
+    // not sorted, and the best move is that of the first line.
+    if (pvGroups > 1)
+    {
+        const usize multiPV = std::min(usize(options["MultiPV"]), rootMoves.size());
+
+        for (usize i = 0; i < multiPV; ++i)
+            threads.multiPVLines.adopt(rootMoves, i);
+
+        uciPvSent = false;
+    }
+    else if (!limits.depth && !skill.enabled())
         bestThread = threads.get_best_thread()->worker.get();
 
     main_manager()->bestPreviousScore        = bestThread->rootMoves[0].score;
@@ -334,6 +378,15 @@ bool Search::Worker::iterative_deepening() {
     {
         rootDepth++;
 
+        // Switch to a network published since the last iteration. The NNUE
+        // state derived from the old one is dropped, the histories are kept.
+        if (pin_network())
+        {
+            accumulatorStack.reset();
+            refreshTable.clear(*pinnedNetwork);
+            evalCache.clear();
+        }
+
         // Age out PV variability metric and signal the start of a new iteration.
         if (mainThread)
         {
@@ -348,6 +401,7 @@ bool Search::Worker::iterative_deepening() {
             rootMoves[i].previousScore      = rootMoves[i].score;
             rootMoves[i].previousPV         = rootMoves[i].pv;
             rootMoves[i].previousScoreExact = i < multiPV;
+            rootMoves[i].adoptedDepth       = 0;
         }
 
         usize pvFirst = pvLast = 0;
@@ -366,6 +420,15 @@ bool Search::Worker::iterative_deepening() {
                         break;
             }
 
+            // With parallel MultiPV, take the latest result of this line unless
+            // this thread's group searches it
+            bool searchLine = true;
+            if (pvGroups > 1)
+            {
+                threads.multiPVLines.adopt(rootMoves, pvIdx);
+                searchLine = pvIdx % pvGroups == threadIdx % pvGroups;
+            }
+
             lastIterationIdxPV = rootMoves[pvIdx].previousPV;
 
             // Reset UCI info selDepth for each depth and each PV line
@@ -385,7 +448,7 @@ bool Search::Worker::iterative_deepening() {
             // high/low, re-search with a bigger window until we don't fail
             // high/low anymore.
             int failedHighCnt = 0;
-            while (true)
+            while (searchLine)
             {
                 // Adjust the effective depth searched, but ensure at least one
                 // effective increment for every four searchAgain steps (see issue #2717).
@@ -440,6 +503,16 @@ bool Search::Worker::iterative_deepening() {
                 assert(alpha >= -VALUE_INFINITE && beta <= VALUE_INFINITE);
             }
 
+            if (searchLine && pvGroups > 1)
+            {
+                // The moves of this line now have scores of this iteration
+                for (usize i = pvIdx; i < pvLast; ++i)
+                    rootMoves[i].adoptedDepth = 0;
+
+                if (!threads.stop)
+                    threads.multiPVLines.publish(rootMoves[pvIdx], pvIdx, rootDepth);
+            }
+
             if (threads.stop && pvIdx)
             {
                 // In multiPV analysis we do not let aborted searches spoil mated-in/
@@ -646,6 +719,7 @@ void Search::Worker::do_move(
 
     Dirties& dirties = accumulatorStack.push();
     pos.do_move(move, st, givesCheck, dirties, &tt, &sharedHistory);
+    accumulatorStack.set_key(st.key);
 
     if (ss != nullptr)
     {
@@ -667,7 +741,7 @@ void Search::Worker::do_null_move(Position& pos, StateInfo& st, Stack* const ss)
 
 void Search::Worker::undo_move(Position& pos, const Move move) {
     pos.undo_move(move);
-    accumulatorStack.pop();
+    accumulatorStack.pop(refreshTable.store);
 }
 
 void Search::Worker::undo_null_move(Position& pos) { pos.undo_null_move(); }
@@ -697,7 +771,28 @@ void Search::Worker::clear() {
     for (usize i = 1; i < reductions.size(); ++i)
         reductions[i] = int(2872 / 128.0 * std::log(i));
 
-    refreshTable.clear(network[numaAccessToken]);
+    pin_network();
+    refreshTable.clear(*pinnedNetwork);
+    evalCache.clear();
+}
+
+bool Search::Worker::pin_network() {
+    if (networkPin && networkPin->version == network.version())
+        return false;
+
+    networkPin    = network.pin();
+    pinnedNetwork = &network.get(networkPin, numaAccessToken);
+    return true;
+}
+
+// Probe counters are a few instructions per node, compiled out with NO_TT_STATS
+void Search::Worker::count_tt_probe([[maybe_unused]] bool            hit,
+                                    [[maybe_unused]] const TTWriter& writer) {
+#ifndef NO_TT_STATS
+    ++ttProbes;
+    ttHits += hit;
+    ttEvictions += !hit && writer.occupied();
+#endif
 }
 
 
@@ -744,6 +839,7 @@ Value Search::Worker::search(
 
     SearchedList capturesSearched;
     SearchedList quietsSearched;
+    SearchedList deferredMoves;
 
     // Step 1. Initialize node
     ss->inCheck   = pos.checkers();
@@ -800,6 +896,8 @@ Value Search::Worker::search(
     excludedMove                   = ss->excludedMove;
     posKey                         = pos.key();
     auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    count_tt_probe(ttHit, ttWriter);
+
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = rootNode ? rootMoves[pvIdx].pv[0] : ttHit ? ttData.move : Move::none();
@@ -1046,13 +1144,16 @@ Value Search::Worker::search(
     {
         assert(probCutBeta < VALUE_INFINITE && probCutBeta > beta);
 
-        MovePicker mp(pos, ttData.move, probCutBeta - ss->staticEval, &captureHistory);
-        Depth      probCutDepth = depth - (improving ? 5 : 3);
+        MovePicker   mp(pos, ttData.move, probCutBeta - ss->staticEval, &captureHistory);
+        TTPrefetcher prefetchNext(tt, pos);
+        Depth        probCutDepth = depth - (improving ? 5 : 3);
 
         while ((move = mp.next_move()) != Move::none())
         {
             assert(move.is_ok());
 
+            prefetchNext(mp);
+
             if (move == excludedMove || !pos.legal(move))
                 continue;
 
@@ -1102,9 +1203,17 @@ moves_loop:  // When in check, search starts here
 
     int moveCount = 0;
 
+    // With the cooperative search, the moves searched at this depth are marked
+    // busy, and at non-PV nodes the moves which another thread is searching are
+    // deferred until the others are done.
+    const bool markBusy    = cooperative && depth >= BusyMoves::MinDepth;
+    const bool deferBusy   = markBusy && !PvNode;
+    int        deferredIdx = 0;
+
     // Step 13. Loop through all pseudo-legal moves until no moves remain
     // or a beta cutoff occurs.
-    while ((move = mp.next_move()) != Move::none())
+    while ((move = mp.next_move()) != Move::none()
+           || (deferredIdx < deferredMoves.ssize() && (move = deferredMoves[deferredIdx++])))
     {
         assert(move.is_ok());
 
@@ -1121,6 +1230,17 @@ moves_loop:  // When in check, search starts here
         if (rootNode && !std::count(rootMoves.begin() + pvIdx, rootMoves.begin() + pvLast, move))
             continue;
 
+        const Key busyKey = markBusy ? BusyMoves::key(pos, move) : 0;
+
+        // The first move is never deferred, and the deferred ones are searched
+        // when they come back whether or not they are still busy.
+        if (deferBusy && moveCount && !deferredIdx
+            && deferredMoves.size() < SEARCHEDLIST_CAPACITY && threads.busyMoves.is_busy(busyKey))
+        {
+            deferredMoves.push_back(move);
+            continue;
+        }
+
         ss->moveCount = ++moveCount;
 
         if (rootNode && is_mainthread() && nodes > NODES_LIMIT_OUTPUT)
@@ -1286,6 +1406,9 @@ moves_loop:  // When in check, search starts here
         u64 nodeCount = rootNode ? u64(nodes) : 0;
 
         // Step 16. Make the move
+        if (markBusy)
+            threads.busyMoves.enter(busyKey);
+
         do_move(pos, move, st, givesCheck, ss);
 
         // Add extension to new depth
@@ -1397,6 +1520,9 @@ moves_loop:  // When in check, search starts here
         // Step 19. Undo move
         undo_move(pos, move);
 
+        if (markBusy)
+            threads.busyMoves.leave(busyKey);
+
         assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
         // Step 20. Check for a new best move
@@ -1668,6 +1794,8 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     // Step 3. Transposition table lookup
     posKey                         = pos.key();
     auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    count_tt_probe(ttHit, ttWriter);
+
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = ttHit ? ttData.move : Move::none();
@@ -1738,6 +1866,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     // captures, or evasions only when in check.
     MovePicker mp(pos, ttData.move, DEPTH_QS, &mainHistory, &lowPlyHistory, &captureHistory,
                   contHist, &sharedHistory, ss->ply);
+    TTPrefetcher prefetchNext(tt, pos);
 
     // Step 5. Loop through all pseudo-legal moves until no moves remain or a beta
     // cutoff occurs.
@@ -1745,6 +1874,8 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     {
         assert(move.is_ok());
 
+        prefetchNext(mp);
+
         if (!pos.legal(move))
             continue;
 
@@ -1866,8 +1997,24 @@ TimePoint Search::Worker::elapsed() const {
 }
 
 Value Search::Worker::evaluate(const Position& pos) {
-    return Eval::evaluate(network[numaAccessToken], pos, accumulatorStack, refreshTable,
-                          optimism[pos.side_to_move()]);
+    if (!evalCache.enabled())
+        return Eval::evaluate(*pinnedNetwork, pos, accumulatorStack, refreshTable,
+                              optimism[pos.side_to_move()]);
+
+    const Key                 key = pos.state()->key;
+    Eval::NNUE::NetworkOutput output;
+
+    ++evalCacheProbes;
+    if (evalCache.probe(key, output))
+        ++evalCacheHits;
+    else
+    {
+        output = pinnedNetwork->evaluate(pos, accumulatorStack, refreshTable);
+        evalCache.save(key, output);
+    }
+
+    auto [psqt, positional] = output;
+    return Eval::evaluate(psqt, positional, pos, optimism[pos.side_to_move()]);
 }
 
 namespace {
@@ -2246,7 +2393,9 @@ void SearchManager::output_pv(Search::Worker&           worker,
         if (depth == 1 && usePreviousScore && i > 0)
             continue;
 
-        Depth d = usePreviousScore ? std::max(1, depth - 1) : depth;
+        Depth d = rootMoves[i].adoptedDepth ? rootMoves[i].adoptedDepth
+                : usePreviousScore          ? std::max(1, depth - 1)
+                                            : depth;
         Value v = usePreviousScore ? rootMoves[i].previousScore : rootMoves[i].uciScore;
 
         if (v == -VALUE_INFINITE)
@@ -2298,6 +2447,43 @@ void SearchManager::output_pv(Search::Worker&           worker,
     }
 }
 
+void MultiPVLines::reset(usize count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    lines.assign(count, Line());
+}
+
+// Keeps the deepest result of the line, the latest one among equal depths
+void MultiPVLines::publish(const RootMove& rm, usize idx, Depth depth) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (idx < lines.size() && depth >= lines[idx].depth)
+        lines[idx] = {depth, rm};
+}
+
+// Brings the move of the line to rootMoves[idx] with the published result, and
+// records its depth for output_pv().
+// A move already among the lines before idx was taken by another line, it is
+// kept there and rootMoves[idx] stays as is.
+void MultiPVLines::adopt(RootMoves& rootMoves, usize idx) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (idx >= lines.size() || !lines[idx].depth)
+        return;
+
+    auto it = std::find(rootMoves.begin() + idx, rootMoves.end(), lines[idx].rootMove.pv[0]);
+    if (it == rootMoves.end())
+        return;
+
+    // Keep the relative order of the other moves, as done in move_to_front()
+    std::rotate(rootMoves.begin() + idx, it, it + 1);
+
+    // The effort is counted per thread for its time management
+    const u64 effort            = rootMoves[idx].effort;
+    rootMoves[idx]              = lines[idx].rootMove;
+    rootMoves[idx].effort       = effort;
+    rootMoves[idx].adoptedDepth = lines[idx].depth;
+}
+
 // Called in case we have no ponder move before exiting the search,
 // for instance, in case we stop the search during a fail high at root.
 // We try hard to have a ponder move to return to the GUI,
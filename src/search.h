@@ -26,6 +26,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -35,6 +36,7 @@
 #include "misc.h"
 #include "nnue/network.h"
 #include "nnue/nnue_accumulator.h"
+#include "nnue/nnue_eval_cache.h"
 #include "numa.h"
 #include "position.h"
 #include "score.h"
@@ -52,6 +54,7 @@ enum NodeType {
 };
 
 class TranspositionTable;
+struct TTWriter;
 class ThreadPool;
 class OptionsMap;
 
@@ -148,6 +151,7 @@ struct RootMove {
     bool    scoreUpperbound    = false;
     bool    previousScoreExact = false;
     int     selDepth           = 0;
+    Depth   adoptedDepth       = 0;  // Depth of a line taken from another MultiPV group
     int     tbRank             = 0;
     Value   tbScore;
     PVMoves pv, previousPV;
@@ -177,6 +181,61 @@ struct LimitsType {
 };
 
 
+// BusyMoves marks the moves which some thread is searching, for the optional
+// cooperative search (ABDADA). At non-PV nodes, a thread defers the moves that
+// another thread has marked and searches them after the others, by then they
+// are likely in the TT. Entries are keyed by the position and the move, the
+// table is small and collisions only defer a move needlessly.
+class BusyMoves {
+   public:
+    // Shallower searches are cheaper to duplicate than to mark
+    static constexpr Depth MinDepth = 5;
+
+    static Key key(const Position& pos, Move m) { return pos.key() ^ make_key(m.raw()); }
+
+    bool is_busy(Key k) const { return entry(k).load(std::memory_order_relaxed) == tag(k); }
+
+    void enter(Key k) { entry(k).store(tag(k), std::memory_order_relaxed); }
+
+    // Clears the mark unless another thread took the entry meanwhile
+    void leave(Key k) {
+        u32 t = tag(k);
+        entry(k).compare_exchange_strong(t, 0, std::memory_order_relaxed);
+    }
+
+   private:
+    static constexpr usize Size = 16384;
+
+    static u32 tag(Key k) { return u32(k >> 32) | 1; }
+
+    std::atomic<u32>&       entry(Key k) { return table[k & (Size - 1)]; }
+    const std::atomic<u32>& entry(Key k) const { return table[k & (Size - 1)]; }
+
+    std::atomic<u32> table[Size] = {};
+};
+
+
+// MultiPVLines holds the lines of a parallel MultiPV search. The threads are
+// split in groups which search every other line in turn, and publish their
+// results here. Before each line, a thread takes the results of the other
+// groups, so that the lines it searches exclude the moves already taken.
+class MultiPVLines {
+   public:
+    void reset(usize count);
+    void publish(const RootMove& rm, usize idx, Depth depth);
+    void adopt(RootMoves& rootMoves, usize idx) const;
+
+   private:
+    struct Line {
+        Depth    depth = 0;
+        RootMove rootMove{Move::none()};
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Line>  lines;
+};
+
+
 // The UCI stores the uci options, thread pool, and transposition table.
 // This struct is used to easily forward data to the Search::Worker class.
 struct SharedState {
@@ -372,14 +431,27 @@ class Worker {
 
     Value evaluate(const Position&);
 
+    // Pins the latest published network, returns false if it already is pinned
+    bool pin_network();
+
+    // Counts the TT probes of the current search for ttstats and speedtest
+    void count_tt_probe(bool hit, const TTWriter& writer);
+
     LimitsType limits;
 
     usize              pvIdx, pvLast;
-    RelaxedAtomic<u64> nodes, tbHits, bestMoveChanges;
+    RelaxedAtomic<u64> nodes, tbHits, bestMoveChanges, ttProbes, ttHits, ttEvictions;
+    RelaxedAtomic<u64> evalCacheProbes, evalCacheHits;
     int                selDepth, nmpMinPly;
 
     Value optimism[COLOR_NB];
 
+    // Defer the moves which other threads are searching, see BusyMoves
+    bool cooperative = false;
+
+    // Number of thread groups of a parallel MultiPV search, see MultiPVLines
+    usize pvGroups = 1;
+
     Position  rootPos;
     StateInfo rootState;
     RootMoves rootMoves;
@@ -404,9 +476,15 @@ class Worker {
     TranspositionTable&                                      tt;
     const LazyNumaReplicatedSystemWide<Eval::NNUE::Network>& network;
 
+    // The network this thread evaluates with. A network published during a
+    // search replaces it at the start of the next iteration, see pin_network().
+    LazyNumaReplicatedSystemWide<Eval::NNUE::Network>::Pin networkPin;
+    const Eval::NNUE::Network*                             pinnedNetwork = nullptr;
+
     // Used by NNUE
     Eval::NNUE::AccumulatorStack  accumulatorStack;
     Eval::NNUE::AccumulatorCaches refreshTable;
+    Eval::NNUE::EvalCache         evalCache;
 
     friend class Stockfish::ThreadPool;
     friend class SearchManager;
@@ -154,12 +154,19 @@ class SharedMemory: public detail::SharedMemoryBase {
     void*              mapped_ptr_ = nullptr;
     T*                 data_ptr_   = nullptr;
     detail::ShmHeader* header_ptr_ = nullptr;
-    usize              total_size_ = 0;
+    usize              header_offset_ = 0;
+    usize              total_size_    = 0;
     std::string        sentinel_base_;
     std::string        sentinel_path_;
 
-    static constexpr usize calculate_total_size() noexcept {
-        return sizeof(T) + sizeof(detail::ShmHeader);
+    // The header is placed after the data, so that the data starts page aligned
+    static constexpr usize calculate_header_offset(usize data_size) noexcept {
+        constexpr usize align = alignof(detail::ShmHeader);
+        return (data_size + align - 1) / align * align;
+    }
+
+    static constexpr usize calculate_total_size(usize data_size) noexcept {
+        return calculate_header_offset(data_size) + sizeof(detail::ShmHeader);
     }
 
     static std::string make_sentinel_base(const std::string& name) {
@@ -172,9 +179,18 @@ class SharedMemory: public detail::SharedMemoryBase {
 
    public:
     explicit SharedMemory(const std::string& name) noexcept :
+        SharedMemory(name, sizeof(T)) {}
+
+    // Creates a region holding data_size bytes, which must be at least sizeof(T).
+    // Only the first T is constructed, the remainder of a new region is zeroed.
+    // This allows sharing arrays whose size is only known at runtime.
+    SharedMemory(const std::string& name, usize data_size) noexcept :
         name_(name),
-        total_size_(calculate_total_size()),
-        sentinel_base_(make_sentinel_base(name)) {}
+        header_offset_(calculate_header_offset(data_size)),
+        total_size_(calculate_total_size(data_size)),
+        sentinel_base_(make_sentinel_base(name)) {
+        assert(data_size >= sizeof(T));
+    }
 
     ~SharedMemory() noexcept override {
         detail::SharedMemoryRegistry::unregister_instance(this);
@@ -190,6 +206,7 @@ class SharedMemory: public detail::SharedMemoryBase {
         mapped_ptr_(other.mapped_ptr_),
         data_ptr_(other.data_ptr_),
         header_ptr_(other.header_ptr_),
+        header_offset_(other.header_offset_),
         total_size_(other.total_size_),
         sentinel_base_(std::move(other.sentinel_base_)),
         sentinel_path_(std::move(other.sentinel_path_)) {
@@ -210,6 +227,7 @@ class SharedMemory: public detail::SharedMemoryBase {
             mapped_ptr_    = other.mapped_ptr_;
             data_ptr_      = other.data_ptr_;
             header_ptr_    = other.header_ptr_;
+            header_offset_ = other.header_offset_;
             total_size_    = other.total_size_;
             sentinel_base_ = std::move(other.sentinel_base_);
             sentinel_path_ = std::move(other.sentinel_path_);
@@ -370,6 +388,8 @@ class SharedMemory: public detail::SharedMemoryBase {
 
     [[nodiscard]] const T& operator*() const noexcept { return *data_ptr_; }
 
+    [[nodiscard]] T* data() const noexcept { return data_ptr_; }
+
     [[nodiscard]] u32 ref_count() const noexcept {
         return header_ptr_ ? header_ptr_->ref_count.load(std::memory_order_acquire) : 0;
     }
@@ -613,7 +633,7 @@ class SharedMemory: public detail::SharedMemoryBase {
 
         data_ptr_ = static_cast<T*>(mapped_ptr_);
         header_ptr_ =
-          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + sizeof(T));
+          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + header_offset_);
 
         new (header_ptr_) detail::ShmHeader{};
         new (data_ptr_) T{initial_value};
@@ -650,7 +670,7 @@ class SharedMemory: public detail::SharedMemoryBase {
 
         data_ptr_   = static_cast<T*>(mapped_ptr_);
         header_ptr_ = std::launder(
-          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + sizeof(T)));
+          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + header_offset_));
 
         if (!header_ptr_->initialized.load(std::memory_order_acquire)
             || header_ptr_->magic != detail::ShmHeader::SHM_MAGIC)
@@ -673,6 +693,15 @@ template<typename T>
     return std::nullopt;
 }
 
+template<typename T>
+[[nodiscard]] std::optional<SharedMemory<T>>
+create_shared(const std::string& name, const T& initial_value, usize data_size) noexcept {
+    SharedMemory<T> shm(name, data_size);
+    if (shm.open(initial_value))
+        return shm;
+    return std::nullopt;
+}
+
 }  // namespace Stockfish::shm
 
 #endif  // #ifndef SHM_LINUX_H_INCLUDED
@@ -143,6 +143,20 @@ Search::SearchManager* ThreadPool::main_manager() { return main_thread()->worker
 
 u64 ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
 u64 ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
+u64 ThreadPool::tt_probes() const { return accumulate(&Search::Worker::ttProbes); }
+u64 ThreadPool::tt_hits() const { return accumulate(&Search::Worker::ttHits); }
+u64 ThreadPool::tt_evictions() const { return accumulate(&Search::Worker::ttEvictions); }
+u64 ThreadPool::eval_cache_probes() const { return accumulate(&Search::Worker::evalCacheProbes); }
+u64 ThreadPool::eval_cache_hits() const { return accumulate(&Search::Worker::evalCacheHits); }
+
+Eval::NNUE::UpdatePathCounts ThreadPool::accumulator_update_paths() const {
+
+    Eval::NNUE::UpdatePathCounts sum{};
+    for (auto&& th : threads)
+        for (usize i = 0; i < sum.size(); ++i)
+            sum[i] += th->worker->accumulatorStack.path_counts()[i];
+    return sum;
+}
 
 static usize next_power_of_two(u64 count) { return count > 1 ? (2ULL << msb(count - 1)) : 1; }
 
@@ -156,6 +170,7 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
     if (threads.size() > 0)  // destroy any existing thread(s)
     {
         main_thread()->wait_for_search_finished();
+        wait_for_search_finished();  // Other threads may still be in a background clear
 
         threads.clear();
 
@@ -251,15 +266,16 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
 
 
 // Sets threadPool data to initial values
-void ThreadPool::clear() {
+void ThreadPool::clear(bool background) {
     if (threads.size() == 0)
         return;
 
     for (auto&& th : threads)
         th->clear_worker();
 
-    for (auto&& th : threads)
-        th->wait_for_search_finished();
+    if (!background)
+        for (auto&& th : threads)
+            th->wait_for_search_finished();
 
     // These two affect the time taken on the first move of a game:
     main_manager()->bestPreviousAverageScore = VALUE_INFINITE;
@@ -271,6 +287,23 @@ void ThreadPool::clear() {
     main_manager()->tm.clear();
 }
 
+// Each thread allocates its own tables, so that they are local to its NUMA node
+void ThreadPool::resize_eval_cache(usize mbSize) {
+    for (auto&& th : threads)
+        th->run_custom_job([&th, mbSize]() { th->worker->evalCache.resize(mbSize); });
+
+    for (auto&& th : threads)
+        th->wait_for_search_finished();
+}
+
+void ThreadPool::resize_accumulator_store(usize mbSize) {
+    for (auto&& th : threads)
+        th->run_custom_job([&th, mbSize]() { th->worker->refreshTable.store.resize(mbSize); });
+
+    for (auto&& th : threads)
+        th->wait_for_search_finished();
+}
+
 void ThreadPool::run_on_thread(usize threadId, std::function<void()> f) {
     assert(threads.size() > threadId);
     threads[threadId]->run_custom_job(std::move(f));
@@ -298,6 +331,8 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
 
     increaseDepth = true;
 
+    const bool cooperative = options["CooperativeSearch"] && size() > 1;
+
     Search::RootMoves rootMoves;
     const auto        legalmoves = MoveList<LEGAL>(pos);
 
@@ -315,6 +350,18 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
 
     Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
 
+    // With parallel MultiPV, each group of threads searches every pvGroups-th
+    // line. The lines of a TB root are ranked first, and the skill level picks
+    // among the lines of a single thread, so both search the lines serially.
+    const usize multiPV = std::min(usize(options["MultiPV"]), rootMoves.size());
+    const Search::Skill skill(options["Skill Level"],
+                              options["UCI_LimitStrength"] ? int(options["UCI_Elo"]) : 0);
+    const usize pvGroups = options["ParallelMultiPV"] && !tbConfig.rootInTB && !skill.enabled()
+                           ? std::min(multiPV, size())
+                           : 1;
+
+    multiPVLines.reset(pvGroups > 1 ? multiPV : 0);
+
     // After ownership transfer 'states' becomes empty, so if we stop the search
     // and call 'go' again without setting a new position states.get() == nullptr.
     assert(states.get() || setupStates.get());
@@ -332,12 +379,17 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
         th->run_custom_job([&]() {
             th->worker->limits = limits;
             th->worker->nodes = th->worker->tbHits = th->worker->bestMoveChanges = 0;
+            th->worker->ttProbes = th->worker->ttHits = th->worker->ttEvictions  = 0;
+            th->worker->evalCacheProbes = th->worker->evalCacheHits              = 0;
+            th->worker->accumulatorStack.clear_path_counts();
             th->worker->nmpMinPly                                                = 0;
             th->worker->rootDepth                                                = 0;
             th->worker->rootMoves                                                = rootMoves;
             th->worker->rootPos.set(pos.fen(), pos.is_chess960(), &th->worker->rootState);
-            th->worker->rootState = setupStates->back();
-            th->worker->tbConfig  = tbConfig;
+            th->worker->rootState   = setupStates->back();
+            th->worker->tbConfig    = tbConfig;
+            th->worker->cooperative = cooperative;
+            th->worker->pvGroups    = pvGroups;
         });
     }
 
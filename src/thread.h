@@ -135,7 +135,9 @@ class ThreadPool {
     void  run_on_thread(usize threadId, std::function<void()> f);
     void  wait_on_thread(usize threadId);
     usize num_threads() const;
-    void  clear();
+    void  clear(bool background = false);  // In the background, the threads' next jobs wait for it
+    void  resize_eval_cache(usize mbSize);
+    void  resize_accumulator_store(usize mbSize);
     void  set(const NumaConfig& numaConfig,
               Search::SharedState,
               const Search::SearchManager::UpdateContext&);
@@ -144,6 +146,11 @@ class ThreadPool {
     Thread*                main_thread() const { return threads.front().get(); }
     u64                    nodes_searched() const;
     u64                    tb_hits() const;
+    u64                    tt_probes() const;
+    u64                    tt_hits() const;
+    u64                    tt_evictions() const;
+    u64                    eval_cache_probes() const;
+    u64                    eval_cache_hits() const;
     Thread*                get_best_thread() const;
     void                   start_searching();
     void                   wait_for_search_finished() const;
@@ -152,9 +159,13 @@ class ThreadPool {
     std::vector<usize> get_bound_thread_count_by_numa_node() const;
     usize              numa_nodes() const;
 
+    Eval::NNUE::UpdatePathCounts accumulator_update_paths() const;
+
     void ensure_network_replicated();
 
-    std::atomic_bool stop, increaseDepth;
+    std::atomic_bool     stop, increaseDepth;
+    Search::BusyMoves    busyMoves;
+    Search::MultiPVLines multiPVLines;
 
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
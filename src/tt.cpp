@@ -20,23 +20,64 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <numeric>
+#include <system_error>
 #include <vector>
 
+#if defined(USE_SSE2)
+    #include <emmintrin.h>
+#elif defined(USE_NEON)
+    #include <arm_neon.h>
+#endif
+
+#include "bitboard.h"
 #include "memory.h"
 #include "misc.h"
+#include "numa.h"
+#include "shm.h"
 #include "syzygy/tbprobe.h"
 #include "thread.h"
 
 namespace Stockfish {
 
 
-// TTEntry struct is the 10 bytes transposition table entry, defined as:
+// The geometry of the table is chosen at compile time with the `ttcluster` variable
+// of the Makefile, so that the geometries can be compared on a given machine with
+// speedtest, which reports the hit rate. An entry stores KeyBits of the key, the
+// other bits are implied by the cluster.
+//
+// 32x3: 3 entries of 10 bytes and 2 bytes of padding per 32-byte cluster (default)
+// 64x6: 6 entries of 10 bytes and 4 bytes of padding per 64-byte cluster
+// 64x5: 5 entries of 12 bytes, with 32-bit keys, and 4 bytes of padding per 64-byte cluster
+struct TTGeometry {
+#if defined(TT_CLUSTER_64x6)
+    using KeyBits                     = u16;
+    static constexpr int ClusterSize  = 6;
+    static constexpr int ClusterBytes = 64;
+#elif defined(TT_CLUSTER_64x5)
+    using KeyBits                     = u32;
+    static constexpr int ClusterSize  = 5;
+    static constexpr int ClusterBytes = 64;
+#else
+    using KeyBits                     = u16;
+    static constexpr int ClusterSize  = 3;
+    static constexpr int ClusterBytes = 32;
+#endif
+};
+
+
+// BasicTTEntry struct is the transposition table entry, 10 bytes with the default
+// 16-bit keys, defined as:
 //
-// key        16 bit
+// key        16 bit  (or 32 bit)
 // depth       8 bit
 // pv node     1 bit
 // bound type  2 bit
@@ -59,7 +100,8 @@ static constexpr u8 BOUND_MASK      = 0b11 << BOUND_SHIFT;
 static constexpr u8 PV_SHIFT        = BOUND_SHIFT + 2;
 static constexpr u8 PV_MASK         = 1 << PV_SHIFT;
 
-struct TTEntry {
+template<typename KeyBits>
+struct BasicTTEntry {
 
     // Convert internal bitfields to external types
     TTData read() const {
@@ -79,32 +121,35 @@ struct TTEntry {
     friend class TranspositionTable;
     friend struct TTWriter;
 
-    RelaxedAtomic<u16>  key16;
-    RelaxedAtomic<u8>   depth8;
-    RelaxedAtomic<u8>   genBound8;
-    RelaxedAtomic<Move> move16;
-    RelaxedAtomic<i16>  value16;
-    RelaxedAtomic<i16>  eval16;
+    RelaxedAtomic<KeyBits> key;
+    RelaxedAtomic<u8>      depth8;
+    RelaxedAtomic<u8>      genBound8;
+    RelaxedAtomic<Move>    move16;
+    RelaxedAtomic<i16>     value16;
+    RelaxedAtomic<i16>     eval16;
 };
 
+struct TTEntry: BasicTTEntry<TTGeometry::KeyBits> {};
+
 // Populates the TTEntry with a new node's data, possibly
 // overwriting an old position. The update is non-atomic and can be racy.
-void TTEntry::save(
+template<typename KeyBits>
+void BasicTTEntry<KeyBits>::save(
   Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, u8 curr_generation) {
 
     // Preserve the old ttmove if we don't have a new one
-    if (m || u16(k) != key16)
+    if (m || KeyBits(k) != key)
         move16 = m;
 
     // Overwrite less valuable entries (cheapest checks first)
-    if (b == BOUND_EXACT || u16(k) != key16 || d - DEPTH_NONE + 2 * pv > depth8 - 4
+    if (b == BOUND_EXACT || KeyBits(k) != key || d - DEPTH_NONE + 2 * pv > depth8 - 4
         || relative_age(curr_generation))
     {
         assert(d > DEPTH_NONE);
         assert(d - DEPTH_NONE < 256);
         assert(curr_generation <= GENERATION_MASK);  // TT::new_search() plays nice
 
-        key16     = u16(k);
+        key       = KeyBits(k);
         depth8    = u8(d - DEPTH_NONE);
         genBound8 = u8(curr_generation | b << BOUND_SHIFT | u8(pv) << PV_SHIFT);
         value16   = i16(v);
@@ -124,7 +169,8 @@ void TTEntry::save(
 }
 
 
-u8 TTEntry::relative_age(const u8 curr_generation) const {
+template<typename KeyBits>
+u8 BasicTTEntry<KeyBits>::relative_age(const u8 curr_generation) const {
     // Returns this entry's age. We count generations like clocks count hours,
     // i.e. we require 0 - 1 == 31. Unsigned subtraction guarantees the required
     // borrowing regardless of the upper pv/bound bits.
@@ -132,15 +178,134 @@ u8 TTEntry::relative_age(const u8 curr_generation) const {
 }
 
 
+// The cold tier is an optional second table which keeps deep entries, so that they
+// are not lost when evicted from the main table by shallower ones. Every write of
+// at least ColdTier::MinDepth is also stored there, and it is probed on main table
+// misses. Entries are packed in 64 bits without the static evaluation:
+//
+// key        20 bit  (bits 8-27 of the key, the bucket is chosen by the high bits)
+// depth       7 bit  (offset by MinDepth)
+// bound type  2 bit
+// pv node     1 bit
+// generation  2 bit  (low bits, only used to prefer replacing stale entries)
+// move       16 bit
+// value      16 bit
+//
+// That is 8 bytes per entry against 10 2/3 in the main table, with a 20 bit key
+// check instead of 16 bits. Entries are read and written with single 64-bit
+// accesses, so unlike main table entries they are never torn. A bucket of eight
+// entries fills one cache line. An all zero entry is empty, as stored entries
+// always have a bound.
+class ColdTier {
+   public:
+    static constexpr Depth MinDepth = 8;
+
+    ColdTier(const ColdTier&)            = delete;
+    ColdTier& operator=(const ColdTier&) = delete;
+
+    ColdTier(usize mbSize) :
+        bucketCount(mbSize * 1024 * 1024 / sizeof(Bucket)),
+        buckets(static_cast<Bucket*>(aligned_large_pages_alloc(bucketCount * sizeof(Bucket)))) {}
+
+    ~ColdTier() { aligned_large_pages_free(buckets); }
+
+    bool is_allocated() const { return buckets != nullptr; }
+
+    // Keys are xored with the salt, which is renewed by soft_clear()
+    void set_salt(Key s) { salt = s; }
+
+    // Zeroes the i-th of n slices of the buckets
+    void clear_slice(usize i, usize n) {
+        const usize stride = bucketCount / n;
+        const usize start  = stride * i;
+        const usize len    = i + 1 != n ? stride : bucketCount - start;
+
+        std::memset(static_cast<void*>(&buckets[start]), 0, len * sizeof(Bucket));
+    }
+
+    std::optional<TTData> probe(Key key) const {
+        key ^= salt;
+
+        const Bucket& bucket = buckets[mul_hi64(key, bucketCount)];
+
+        for (const auto& slot : bucket.entry)
+        {
+            const u64 e = slot;
+            if (e && tag(e) == key_tag(key))
+                return TTData{Move(u16(e >> 32)),
+                              Value(i16(e >> 48)),
+                              VALUE_NONE,
+                              Depth(MinDepth + ((e >> 20) & 0x7F)),
+                              Bound((e >> 27) & 0x3),
+                              bool((e >> 29) & 0x1)};
+        }
+
+        return std::nullopt;
+    }
+
+    void save(Key key, Value v, bool pv, Bound b, Depth d, Move m, u8 generation8) {
+        assert(d >= MinDepth && b != BOUND_NONE);
+
+        key ^= salt;
+
+        const u64 e = key_tag(key) | u64(std::min(d - MinDepth, 0x7F)) << 20 | u64(b) << 27
+                    | u64(pv) << 29 | u64(generation8 & 0x3) << 30 | u64(m.raw()) << 32
+                    | u64(u16(i16(v))) << 48;
+
+        Bucket& bucket  = buckets[mul_hi64(key, bucketCount)];
+        auto    worth   = [generation8](u64 x) {
+            return int((x >> 20) & 0x7F) - 8 * int((generation8 - ((x >> 30) & 0x3)) & 0x3);
+        };
+        RelaxedAtomic<u64>* replace = nullptr;
+
+        for (auto& slot : bucket.entry)
+        {
+            const u64 old = slot;
+
+            // Keep the deeper search of the same position, unless it is stale
+            if (old && tag(old) == key_tag(key))
+            {
+                if (b == BOUND_EXACT || worth(e) >= worth(old) - 2)
+                    slot = e;
+                return;
+            }
+
+            if (!replace || !old || (*replace && worth(old) < worth(*replace)))
+                replace = &slot;
+        }
+
+        *replace = e;
+    }
+
+   private:
+    struct alignas(64) Bucket {
+        RelaxedAtomic<u64> entry[8];
+    };
+
+    static u64 key_tag(Key key) { return (key >> 8) & 0xFFFFF; }
+    static u64 tag(u64 e) { return e & 0xFFFFF; }
+
+    usize   bucketCount;
+    Bucket* buckets;
+    Key     salt = 0;
+};
+
+
 // TTWriter is but a very thin wrapper around the pointer
-TTWriter::TTWriter(TTEntry* tte) :
-    entry(tte) {}
+TTWriter::TTWriter(TTEntry* tte, ColdTier* cold) :
+    entry(tte),
+    coldTier(cold) {}
 
 void TTWriter::write(
   Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, u8 curr_generation) {
     entry->save(k, v, pv, b, d, m, ev, curr_generation);
+
+    if (coldTier && d >= ColdTier::MinDepth && b != BOUND_NONE)
+        coldTier->save(k, v, pv, b, d, m, curr_generation);
 }
 
+bool TTWriter::occupied() const { return entry->is_occupied(); }
+
 void TTWriter::penalize(int penalty) {
     // guard against racy underflows, default to "unoccupied"
     entry->depth8 = std::max(int(entry->depth8) - penalty, 0);
@@ -151,30 +316,217 @@ void TTWriter::penalize(int penalty) {
 // of TTEntry. Each non-empty TTEntry contains information on exactly one position. The size of a Cluster should
 // divide the size of a cache line for best performance, as the cacheline is prefetched when possible.
 
-static constexpr int ClusterSize = 3;
+static constexpr int ClusterSize = TTGeometry::ClusterSize;
+
+// The alignment pads the entries to the size of the cluster. The padding holds the
+// epoch of the entries, see soft_clear().
+template<typename Entry, int Size, int Bytes>
+struct alignas(Bytes) BasicCluster {
+    Entry              entry[Size];
+    RelaxedAtomic<u16> epoch16;
+};
+
+struct Cluster: BasicCluster<TTEntry, ClusterSize, TTGeometry::ClusterBytes> {};
+
+static_assert(sizeof(Cluster) == TTGeometry::ClusterBytes, "Entries do not fit in the cluster");
+
+
+// Vectorized scans of a cluster, which compare all of its entries at once instead of
+// one at a time. Entry sizes and field offsets are multiples of the key size, so
+// that each key fills whole lanes of its size, and so does the depth and generation
+// byte pair of an entry in 16-bit lanes. The cluster is read with plain vector loads
+// while other threads may write to it. This is as benign as the racy reads of single
+// entries, but the thread sanitizer cannot know, so it gets the scalar scans.
+#if defined(__has_feature)
+    #if __has_feature(thread_sanitizer)
+        #define TT_THREAD_SANITIZER
+    #endif
+#endif
+
+#if (defined(USE_SSE2) || (defined(USE_NEON) && defined(__aarch64__))) \
+  && !defined(__SANITIZE_THREAD__) && !defined(TT_THREAD_SANITIZER) && !defined(__AARCH64EB__)
+    #define USE_TT_SIMD
+
+constexpr int TTChunkCount  = sizeof(Cluster) / 16;
+constexpr int TTDepthOffset = sizeof(TTGeometry::KeyBits);  // The depth, then generation
+
+static_assert(sizeof(TTEntry) % sizeof(TTGeometry::KeyBits) == 0);
+static_assert(sizeof(Cluster) % 16 == 0);
+
+// Lane constants of victim_entry(). The 16-bit lanes holding the depth and generation
+// of an entry keep their score and add their index, the other lanes never win.
+struct VictimLanes {
+    u16 keep[sizeof(Cluster) / 2];
+    u16 base[sizeof(Cluster) / 2];
+};
+
+constexpr VictimLanes make_victim_lanes() {
+    VictimLanes lanes{};
+
+    for (usize l = 0; l < sizeof(Cluster) / 2; ++l)
+    {
+        lanes.keep[l] = 0;
+        lanes.base[l] = 0x7FFF;
+    }
+
+    for (int i = 0; i < ClusterSize; ++i)
+    {
+        const int l   = (i * int(sizeof(TTEntry)) + TTDepthOffset) / 2;
+        lanes.keep[l] = 0xFFFF;
+        lanes.base[l] = u16(l);
+    }
+
+    return lanes;
+}
+
+alignas(16) constexpr VictimLanes TTVictimLanes = make_victim_lanes();
+
+// Returns the mask of the entries of the cluster with the given key bits
+inline u32 matching_entries(const TTEntry* cluster, TTGeometry::KeyBits keyBits) {
+
+    constexpr bool Wide = sizeof(keyBits) == 4;
+
+    // Per chunk, the compare result of each byte: one bit on x86, four with NEON
+    u64 byteMasks[TTChunkCount];
+
+    #if defined(USE_SSE2)
+    constexpr int BitsPerByte = 1;
+
+    const __m128i needle = Wide ? _mm_set1_epi32(i32(keyBits)) : _mm_set1_epi16(i16(keyBits));
 
-struct Cluster {
-    TTEntry entry[ClusterSize];
-    char    padding[2];  // Pad to 32 bytes
+    for (int c = 0; c < TTChunkCount; ++c)
+    {
+        const __m128i chunk = _mm_load_si128(reinterpret_cast<const __m128i*>(cluster) + c);
+        const __m128i eq = Wide ? _mm_cmpeq_epi32(chunk, needle) : _mm_cmpeq_epi16(chunk, needle);
+        byteMasks[c]     = u32(_mm_movemask_epi8(eq));
+    }
+    #else
+    constexpr int BitsPerByte = 4;
+
+    for (int c = 0; c < TTChunkCount; ++c)
+    {
+        const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const u8*>(cluster) + 16 * c);
+        const uint8x16_t eq =
+          Wide ? vreinterpretq_u8_u32(vceqq_u32(vreinterpretq_u32_u8(chunk), vdupq_n_u32(keyBits)))
+               : vreinterpretq_u8_u16(vceqq_u16(vreinterpretq_u16_u8(chunk), vdupq_n_u16(keyBits)));
+        byteMasks[c] = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    }
+    #endif
+
+    u32 mask = 0;
+    for (int i = 0; i < ClusterSize; ++i)
+    {
+        const int offset = i * int(sizeof(TTEntry));
+        mask |= u32(byteMasks[offset / 16] >> (offset % 16 * BitsPerByte) & 1) << i;
+    }
+
+    return mask;
+}
+
+// Returns the index of the entry to replace, the first one of lowest value. As in
+// the scalar scan, the value of an entry is its depth minus 8 times its relative age.
+// The 9-bit biased value goes in the high bits of each lane and the lane index in the
+// low 5 bits, so a single min over all lanes finds both.
+inline int victim_entry(const TTEntry* cluster, u8 generation8) {
+
+    #if defined(USE_SSE2)
+    const __m128i generation = _mm_set1_epi16(generation8);
+    __m128i       best       = _mm_set1_epi16(0x7FFF);
+
+    for (int c = 0; c < TTChunkCount; ++c)
+    {
+        const __m128i chunk = _mm_load_si128(reinterpret_cast<const __m128i*>(cluster) + c);
+        const __m128i depth = _mm_and_si128(chunk, _mm_set1_epi16(0xFF));
+        const __m128i age   = _mm_and_si128(_mm_sub_epi16(generation, _mm_srli_epi16(chunk, 8)),
+                                            _mm_set1_epi16(GENERATION_MASK));
+        const __m128i value =
+          _mm_sub_epi16(_mm_add_epi16(depth, _mm_set1_epi16(256)), _mm_slli_epi16(age, 3));
+        const __m128i keep =
+          _mm_load_si128(reinterpret_cast<const __m128i*>(TTVictimLanes.keep) + c);
+        const __m128i base =
+          _mm_load_si128(reinterpret_cast<const __m128i*>(TTVictimLanes.base) + c);
+
+        best = _mm_min_epi16(best, _mm_or_si128(_mm_and_si128(_mm_slli_epi16(value, 5), keep), base));
+    }
+
+    best = _mm_min_epi16(best, _mm_shuffle_epi32(best, 0x4E));
+    best = _mm_min_epi16(best, _mm_shuffle_epi32(best, 0xB1));
+    best = _mm_min_epi16(best, _mm_shufflelo_epi16(best, 0xB1));
+
+    const int lane = _mm_cvtsi128_si32(best) & 31;
+    #else
+    const uint16x8_t generation = vdupq_n_u16(generation8);
+    uint16x8_t       best       = vdupq_n_u16(0x7FFF);
+
+    for (int c = 0; c < TTChunkCount; ++c)
+    {
+        const uint16x8_t chunk = vld1q_u16(reinterpret_cast<const u16*>(cluster) + 8 * c);
+        const uint16x8_t depth = vandq_u16(chunk, vdupq_n_u16(0xFF));
+        const uint16x8_t age =
+          vandq_u16(vsubq_u16(generation, vshrq_n_u16(chunk, 8)), vdupq_n_u16(GENERATION_MASK));
+        const uint16x8_t value = vsubq_u16(vaddq_u16(depth, vdupq_n_u16(256)), vshlq_n_u16(age, 3));
+        const uint16x8_t keep  = vld1q_u16(TTVictimLanes.keep + 8 * c);
+        const uint16x8_t base  = vld1q_u16(TTVictimLanes.base + 8 * c);
+
+        best = vminq_u16(best, vorrq_u16(vandq_u16(vshlq_n_u16(value, 5), keep), base));
+    }
+
+    const int lane = vminvq_u16(best) & 31;
+    #endif
+
+    return (lane * 2 - TTDepthOffset) / int(sizeof(TTEntry));
+}
+
+#endif
+
+
+// The shared memory holding a shared table. Only Linux is supported for now, as
+// the table must be sized at runtime, which the other shm backends cannot do.
+#if defined(__linux__) && !defined(__ANDROID__)
+    #define HAS_SHARED_TT
+
+struct TranspositionTable::SharedTable {
+    shm::SharedMemory<char> memory;
 };
+#else
+struct TranspositionTable::SharedTable {};
+#endif
+
 
-static_assert(sizeof(Cluster) == 32, "Suboptimal Cluster size");
+TranspositionTable::TranspositionTable() = default;
+
+TranspositionTable::~TranspositionTable() { free_table(); }
 
 
 // Sets the size of the transposition table,
 // measured in megabytes. Transposition table consists
 // of clusters and each cluster consists of ClusterSize number of TTEntry.
-void TranspositionTable::resize(usize mbSize, ThreadPool& threads) {
-    aligned_large_pages_free(table);
+bool TranspositionTable::resize(usize              mbSize,
+                                ThreadPool&        threads,
+                                const NumaConfig&  numaConfig,
+                                TTPlacement        ttPlacement,
+                                const std::string& sharedName) {
+
+    // Keep the old table until its entries have been moved to the new one
+    TranspositionTable old;
+    std::swap(old.table, table);
+    std::swap(old.clusterCount, clusterCount);
+    std::swap(old.mappedBytes, mappedBytes);
+    std::swap(old.sharedTable, sharedTable);
+    old.generation8 = generation8;
+    old.epoch       = epoch;
 
     clusterCount  = mbSize * 1024 * 1024 / sizeof(Cluster);
     usize ttBytes = clusterCount * sizeof(Cluster);
 
+    const bool shared = !sharedName.empty() && open_shared(sharedName, ttBytes);
+
     // Request 1GB pages if we'd get at least eight per NUMA node, to avoid
     // memory oversubscription
     bool hugePageHint = ttBytes >= threads.numa_nodes() * HugePageSize * 8;
 
-    table = static_cast<Cluster*>(aligned_large_pages_alloc_with_hint(ttBytes, hugePageHint));
+    if (!shared)
+        table = static_cast<Cluster*>(aligned_large_pages_alloc_with_hint(ttBytes, hugePageHint));
 
     if (!table)
     {
@@ -182,14 +534,250 @@ void TranspositionTable::resize(usize mbSize, ThreadPool& threads) {
         exit(EXIT_FAILURE);
     }
 
-    clear(threads);
+    placement = ttPlacement;
+    placementRanges.clear();
+
+    // Empty if the threads are not bound, they may then run on any node
+    std::vector<usize> threadsPerNode = threads.get_bound_thread_count_by_numa_node();
+
+    if (placement == TTPlacement::Interleave)
+    {
+        std::set<usize> systemNodes;
+        for (NumaIndex n = 0; n < numaConfig.num_numa_nodes(); ++n)
+            if (threadsPerNode.empty() || (n < threadsPerNode.size() && threadsPerNode[n]))
+                systemNodes.merge(numaConfig.system_numa_nodes(n));
+
+        placementRanges.push_back({0, ttBytes, std::move(systemNodes)});
+    }
+    else if (placement == TTPlacement::NodeLocal)
+    {
+        if (threadsPerNode.empty())
+            threadsPerNode.push_back(threads.num_threads());
+
+        // Follow the slicing of clear(), where the threads are ordered by node and
+        // each clears `stride` clusters. Range boundaries are rounded down to 2MB
+        // so that transparent huge pages are not split between nodes.
+        constexpr usize Alignment   = 2 * 1024 * 1024;
+        const usize     threadCount = threads.num_threads();
+        const usize     stride      = clusterCount / threadCount;
+        usize           first       = 0;
+
+        for (NumaIndex n = 0; n < threadsPerNode.size() && n < numaConfig.num_numa_nodes(); ++n)
+        {
+            if (!threadsPerNode[n])
+                continue;
+
+            const usize last  = first + threadsPerNode[n];
+            const usize begin = stride * first * sizeof(Cluster) / Alignment * Alignment;
+            const usize end   = last >= threadCount
+                                ? ttBytes
+                                : stride * last * sizeof(Cluster) / Alignment * Alignment;
+
+            if (begin < end)
+                placementRanges.push_back({begin, end, numaConfig.system_numa_nodes(n)});
+
+            first = last;
+        }
+    }
+
+    apply_placement();
+
+    // A shared table is zeroed when created, and may already hold entries from
+    // other processes, so it is neither cleared nor merged into.
+    if (!shared)
+    {
+        clear_table(threads);
+
+        if (old.table && !old.sharedTable)
+            rehash_from(old, threads);
+    }
+
+    return shared || sharedName.empty();
+}
+
+
+// Returns i * num / den, rounded down or up. This is exact unless i * num overflows
+// 64 bits, which only happens with huge tables, and where the approximation only
+// affects the clusters at the boundaries.
+static usize scale_index(usize i, usize num, usize den, bool roundUp) {
+    if (num == 0 || i <= (std::numeric_limits<usize>::max() - den) / num)
+        return (i * num + (roundUp ? den - 1 : 0)) / den;
+
+    const long double x = static_cast<long double>(i) * num / den;
+    return usize(roundUp ? std::ceil(x) : std::floor(x));
+}
+
+
+// Moves the entries of the old table into this one, which must be freshly cleared.
+// Entries only store 16 bits of their key, so the new cluster of an entry is only
+// known to be among those covering the key range of its old cluster. When shrinking
+// this is usually a single cluster. When growing, the entry is copied into each of
+// them. The copies in the wrong clusters can still be found through a 16-bit key
+// collision, like any other entry, so all copies get the oldest relative age: they
+// are replaced first and not counted by hashfull(). A table grown by more than
+// MaxRehashGrowth times is left empty, as the copies would crowd out the new entries.
+// If more entries compete for a cluster than it holds, the most valuable ones are
+// kept, as by the replacement strategy.
+//
+// The new clusters are split in contiguous ranges over the threads, and each thread
+// only writes to its own range, so that the rehash is race free and runs in time
+// proportional to the table size.
+void TranspositionTable::rehash_from(const TranspositionTable& old, ThreadPool& threads) {
+
+    generation8 = old.generation8;
+    epoch       = old.epoch;
+
+    const usize threadCount = threads.num_threads();
+    const usize oldCount    = old.clusterCount;
+
+    if (clusterCount > MaxRehashGrowth * oldCount)
+        return;
+
+    for (usize t = 0; t < threadCount; ++t)
+    {
+        threads.run_on_thread(t, [this, &old, t, threadCount, oldCount]() {
+            const usize stride = clusterCount / threadCount;
+            const usize begin  = stride * t;
+            const usize end    = t + 1 != threadCount ? stride * (t + 1) : clusterCount;
+
+            for (usize j = begin; j < end; ++j)
+                table[j].epoch16 = epoch;
+
+            auto entryValue = [this](const TTEntry& e) {
+                return e.depth8 - 8 * e.relative_age(generation8);
+            };
+
+            auto insert = [&](Cluster& cluster, const TTEntry& e) {
+                TTEntry* replace = nullptr;
+
+                for (TTEntry& slot : cluster.entry)
+                {
+                    if (!slot.is_occupied() || slot.key == e.key)
+                    {
+                        replace = &slot;
+                        break;
+                    }
+
+                    if (!replace || entryValue(slot) < entryValue(*replace))
+                        replace = &slot;
+                }
+
+                if (!replace->is_occupied() || entryValue(e) > entryValue(*replace))
+                    *replace = e;
+            };
+
+            // The old clusters which may have entries belonging to [begin, end)
+            const usize first = std::min(scale_index(begin, oldCount, clusterCount, false), oldCount);
+            const usize last  = std::min(scale_index(end, oldCount, clusterCount, true) + 1, oldCount);
+
+            for (usize i = first; i < last; ++i)
+            {
+                // The new clusters covering the keys of old cluster i
+                const usize lo = scale_index(i, clusterCount, oldCount, false);
+                const usize hi = scale_index(i + 1, clusterCount, oldCount, true) - 1;
+
+                if (old.table[i].epoch16 != old.epoch)
+                    continue;
+
+                for (const TTEntry& e : old.table[i].entry)
+                {
+                    if (!e.is_occupied())
+                        continue;
+
+                    TTEntry copy = e;
+                    if (hi > lo)
+                        copy.genBound8 = u8((e.genBound8 & ~GENERATION_MASK)
+                                            | ((generation8 + 1) & GENERATION_MASK));
+
+                    for (usize j = std::max(lo, begin); j <= hi && j < end; ++j)
+                        insert(table[j], copy);
+                }
+            }
+        });
+    }
+
+    for (usize t = 0; t < threadCount; ++t)
+        threads.wait_on_thread(t);
+}
+
+
+// Attaches to the shared table of the given name and size, creating it if no other
+// process uses it. The segment name includes the size and the executable, so that
+// only identical tables are shared. It is removed when the last user detaches.
+bool TranspositionTable::open_shared([[maybe_unused]] const std::string& name,
+                                     [[maybe_unused]] usize              ttBytes) {
+#ifdef HAS_SHARED_TT
+    char shmName[32];
+    std::snprintf(
+      shmName, sizeof(shmName), "/sf_tt_%016" PRIx64,
+      hash_string(name + "$" + std::to_string(ttBytes) + "$" + getExecutablePathHash()));
+
+    auto memory = shm::create_shared<char>(shmName, 0, ttBytes);
+    if (!memory)
+        return false;
+
+    table       = reinterpret_cast<Cluster*>(memory->data());
+    sharedTable = std::make_unique<SharedTable>(SharedTable{std::move(*memory)});
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+// Applies the NUMA placement to the current table. Failures are not fatal, the
+// pages then simply end up wherever the OS puts them.
+void TranspositionTable::apply_placement() {
+    char* base = reinterpret_cast<char*>(table);
+
+    for (const auto& range : placementRanges)
+        set_numa_placement(base + range.begin, range.end - range.begin, range.systemNodes,
+                           placement == TTPlacement::Interleave);
+}
+
+
+// Samples on which system NUMA nodes the pages of the table reside
+std::map<int, usize> TranspositionTable::numa_placement() const {
+    std::map<int, usize> pagesPerNode;
+
+    for (int node : sample_numa_placement(table, clusterCount * sizeof(Cluster), 1000))
+        ++pagesPerNode[node];
+
+    return pagesPerNode;
+}
+
+
+// Releases the table, whether it was allocated, shared or mapped from a snapshot
+void TranspositionTable::free_table() {
+    if (sharedTable)
+        sharedTable.reset();
+    else if (mappedBytes)
+        unmap_file(table, mappedBytes);
+    else
+        aligned_large_pages_free(table);
+
+    table       = nullptr;
+    mappedBytes = 0;
 }
 
 
 // Initializes the entire transposition table to zero,
 // in a multi-threaded way.
 void TranspositionTable::clear(ThreadPool& threads) {
-    generation8             = 0;
+    clear_table(threads);
+    clear_cold_tier(threads);
+}
+
+
+// Zeroes the main table only, the cold tier is keyed by full keys and survives resizes
+void TranspositionTable::clear_table(ThreadPool& threads) {
+    generation8 = 0;
+    epoch       = 0;
+
+    // Other processes may still be searching with a shared table
+    if (sharedTable)
+        return;
+
     const usize threadCount = threads.num_threads();
 
     std::vector<usize> threadToNuma = threads.get_bound_thread_to_numa_node();
@@ -223,6 +811,41 @@ void TranspositionTable::clear(ThreadPool& threads) {
 }
 
 
+void TranspositionTable::clear_cold_tier(ThreadPool& threads) {
+    if (!coldTier)
+        return;
+
+    coldTier->set_salt(0);
+
+    const usize threadCount = threads.num_threads();
+
+    for (usize i = 0; i < threadCount; ++i)
+        threads.run_on_thread(i, [this, i, threadCount]() { coldTier->clear_slice(i, threadCount); });
+
+    for (usize i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+}
+
+
+void TranspositionTable::resize_cold_tier(usize mbSize, ThreadPool& threads) {
+    coldTier.reset();
+
+    if (!mbSize)
+        return;
+
+    coldTier = std::make_unique<ColdTier>(mbSize);
+
+    if (!coldTier->is_allocated())
+    {
+        std::cerr << "Failed to allocate " << mbSize << "MB for the cold transposition table tier."
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    clear_cold_tier(threads);
+}
+
+
 // Returns an approximation of the hashtable
 // occupation during a search. The hash is x permill full, as per UCI protocol.
 // Only counts entries which are younger than maxAge.
@@ -230,13 +853,235 @@ int TranspositionTable::hashfull(int maxAge) const {
     int cnt = 0;
     for (int i = 0; i < 1000; ++i)
         for (int j = 0; j < ClusterSize; ++j)
-            cnt += table[i].entry[j].is_occupied()
+            cnt += table[i].epoch16 == epoch && table[i].entry[j].is_occupied()
                 && table[i].entry[j].relative_age(generation8) <= maxAge;
 
     return cnt / ClusterSize;
 }
 
 
+TTStats TranspositionTable::stats(ThreadPool& threads, usize sampleClusters) const {
+
+    static_assert(GENERATION_MASK + 1 == std::tuple_size_v<decltype(TTStats::age)>);
+
+    const usize count       = sampleClusters ? std::min(sampleClusters, clusterCount) : clusterCount;
+    const usize threadCount = threads.num_threads();
+
+    std::vector<TTStats> partial(threadCount);
+
+    for (usize t = 0; t < threadCount; ++t)
+    {
+        threads.run_on_thread(t, [this, &partial, t, threadCount, count]() {
+            const usize stride = count / threadCount;
+            const usize begin  = stride * t;
+            const usize end    = t + 1 != threadCount ? stride * (t + 1) : count;
+            TTStats&    s      = partial[t];
+
+            for (usize i = begin; i < end; ++i)
+            {
+                const Cluster& cluster = table[scale_index(i, clusterCount, count, false)];
+
+                for (const TTEntry& e : cluster.entry)
+                {
+                    if (cluster.epoch16 != epoch || !e.is_occupied())
+                        continue;
+
+                    const u8 genBound = e.genBound8;
+
+                    ++s.occupied;
+                    ++s.depth[e.depth8];
+                    ++s.age[e.relative_age(generation8)];
+                    ++s.bound[(genBound & BOUND_MASK) >> BOUND_SHIFT];
+                    s.pv += bool(genBound & PV_MASK);
+                }
+            }
+
+            s.clusters = end - begin;
+            s.entries  = s.clusters * ClusterSize;
+        });
+    }
+
+    for (usize t = 0; t < threadCount; ++t)
+        threads.wait_on_thread(t);
+
+    TTStats total;
+
+    for (const TTStats& s : partial)
+    {
+        total.clusters += s.clusters;
+        total.entries += s.entries;
+        total.occupied += s.occupied;
+        total.pv += s.pv;
+
+        for (usize i = 0; i < total.depth.size(); ++i)
+            total.depth[i] += s.depth[i];
+        for (usize i = 0; i < total.age.size(); ++i)
+            total.age[i] += s.age[i];
+        for (usize i = 0; i < total.bound.size(); ++i)
+            total.bound[i] += s.bound[i];
+    }
+
+    return total;
+}
+
+
+// A TT snapshot is a header followed by a raw image of the cluster array. The
+// header is padded to SnapshotHeaderSize bytes, so that the clusters start at an
+// offset which is page aligned on all supported platforms and can be mapped
+// directly as the table. The image is in native byte order and layout, which
+// the header records, so a snapshot is only accepted by a compatible build.
+static constexpr char  SnapshotMagic[8]   = {'S', 'F', 'T', 'T', 'S', 'N', 'A', 'P'};
+static constexpr u32   SnapshotVersion    = 3;
+static constexpr usize SnapshotHeaderSize = 64 * 1024;
+
+struct SnapshotHeader {
+    char magic[8];
+    u32  version;
+    u32  clusterBytes;
+    u64  clusterCount;
+    u8   entriesPerCluster;
+    u8   generation8;
+    u8   littleEndian;
+    u16  epoch;
+};
+
+static_assert(sizeof(SnapshotHeader) <= SnapshotHeaderSize);
+
+
+// Writes the table to a snapshot file. The snapshot is first written to a
+// temporary file and then renamed, so that an interrupted save never leaves a
+// truncated snapshot behind, and a file currently mapped as the table is
+// never modified in place.
+std::optional<std::string> TranspositionTable::save(const std::filesystem::path& file) const {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+    header.version           = SnapshotVersion;
+    header.clusterBytes      = sizeof(Cluster);
+    header.clusterCount      = clusterCount;
+    header.entriesPerCluster = ClusterSize;
+    header.generation8       = generation8;
+    header.littleEndian      = IsLittleEndian;
+    header.epoch             = epoch;
+
+    std::vector<char> headerBytes(SnapshotHeaderSize, 0);
+    std::memcpy(headerBytes.data(), &header, sizeof(header));
+
+    std::filesystem::path tmpFile = file;
+    tmpFile += ".tmp";
+
+    {
+        std::ofstream stream(tmpFile, std::ios::binary | std::ios::trunc);
+        stream.write(headerBytes.data(), headerBytes.size());
+        stream.write(reinterpret_cast<const char*>(table), clusterCount * sizeof(Cluster));
+
+        if (!stream)
+            return "Failed to write transposition table snapshot " + tmpFile.string();
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpFile, file, ec);
+    if (ec)
+        return "Failed to rename " + tmpFile.string() + " to " + file.string() + ": "
+             + ec.message();
+
+    return std::nullopt;
+}
+
+
+// Restores the table from a snapshot file written by save(). Where supported, the
+// clusters are mapped copy-on-write instead of being read, so that pages are only
+// loaded when first probed and the table is usable immediately. A snapshot taken
+// with another Hash size is rehashed into the current table instead. The snapshot
+// file must not be modified or truncated by other processes while it is mapped.
+std::optional<std::string> TranspositionTable::load(const std::filesystem::path& file,
+                                                    ThreadPool&                  threads) {
+    std::ifstream  stream(file, std::ios::binary);
+    SnapshotHeader header{};
+
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return "Failed to read transposition table snapshot " + file.string();
+
+    if (std::memcmp(header.magic, SnapshotMagic, sizeof(SnapshotMagic))
+        || header.version != SnapshotVersion)
+        return file.string() + " is not a compatible transposition table snapshot";
+
+    if (header.clusterBytes != sizeof(Cluster) || header.entriesPerCluster != ClusterSize
+        || header.littleEndian != IsLittleEndian || header.generation8 > GENERATION_MASK)
+        return file.string() + " was written by an incompatible build";
+
+    if (sharedTable)
+        return "A snapshot cannot be loaded into a shared transposition table";
+
+    stream.seekg(0, std::ios::end);
+    const usize fileSize = stream ? usize(stream.tellg()) : 0;
+
+    if (!header.clusterCount || fileSize < SnapshotHeaderSize
+        || (fileSize - SnapshotHeaderSize) / sizeof(Cluster) < header.clusterCount)
+        return "Transposition table snapshot " + file.string() + " is truncated";
+
+    // Map or read the snapshot as a table of its own first, so that the current
+    // table stays valid on failure
+    const usize        snapshotBytes = header.clusterCount * sizeof(Cluster);
+    TranspositionTable snapshot;
+    snapshot.clusterCount = header.clusterCount;
+    snapshot.generation8  = header.generation8;
+    snapshot.epoch        = header.epoch;
+
+    if (void* mem = map_file_private(file, SnapshotHeaderSize, snapshotBytes))
+    {
+        snapshot.table       = static_cast<Cluster*>(mem);
+        snapshot.mappedBytes = snapshotBytes;
+    }
+    else
+    {
+        snapshot.table = static_cast<Cluster*>(aligned_large_pages_alloc(snapshotBytes));
+        if (!snapshot.table)
+            return "Failed to allocate memory for transposition table snapshot";
+
+        stream.seekg(SnapshotHeaderSize);
+        if (!stream.read(reinterpret_cast<char*>(snapshot.table), snapshotBytes))
+            return "Failed to read transposition table snapshot " + file.string();
+    }
+
+    // A snapshot of the same size becomes the table, others are rehashed into it
+    if (snapshot.clusterCount == clusterCount)
+    {
+        std::swap(table, snapshot.table);
+        std::swap(mappedBytes, snapshot.mappedBytes);
+        generation8 = snapshot.generation8;
+        epoch       = snapshot.epoch;
+        apply_placement();
+    }
+    else
+    {
+        clear_table(threads);
+        rehash_from(snapshot, threads);
+    }
+
+    return std::nullopt;
+}
+
+
+// Invalidates all entries in constant time. Each cluster is tagged with the epoch
+// its entries were written in, and a cluster of an older epoch is emptied when it is
+// next probed. Until then its entries are neither found nor counted by hashfull(),
+// and the rehash on resize skips them. The cold tier is keyed by full keys, there a
+// new salt sends the keys to other buckets. Returns false if the table must be
+// cleared instead: a shared table is not tagged, as the processes would have to
+// agree on the epoch, and the 16-bit tags must not wrap around.
+bool TranspositionTable::soft_clear() {
+    if (sharedTable || u16(epoch + 1) == 0)
+        return false;
+
+    ++epoch;
+
+    if (coldTier)
+        coldTier->set_salt(PRNG(epoch).rand<Key>());
+
+    return true;
+}
+
+
 void TranspositionTable::new_search() {
     ++generation8;
     // Don't overflow into the other bits of TTEntry::genBound8
@@ -247,20 +1092,51 @@ void TranspositionTable::new_search() {
 u8 TranspositionTable::generation() const { return generation8; }
 
 
+usize TranspositionTable::size_mb() const { return clusterCount * sizeof(Cluster) / (1024 * 1024); }
+
+
+std::string TranspositionTable::cluster_geometry() {
+    return std::to_string(sizeof(Cluster)) + "x" + std::to_string(ClusterSize) + ", "
+         + std::to_string(8 * sizeof(TTGeometry::KeyBits)) + "-bit keys";
+}
+
+
 // Looks up the current position in the transposition table.
 // It returns true if the key is found (which may be a collision), and has non-null data.
 // Otherwise, it returns false and a pointer to an empty or least valuable TTEntry
 // to be replaced later. The value of an entry is its depth minus 8 times its relative age.
 std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) const {
 
-    TTEntry* const tte   = first_entry(key);
-    const u16      key16 = u16(key);  // Use the low 16 bits as key inside the cluster
+    Cluster&       cluster = table[mul_hi64(key, clusterCount)];
+    TTEntry* const tte     = cluster.entry;
+    const auto     keyBits = TTGeometry::KeyBits(key);  // Use the low bits as key inside the cluster
 
+    // Empty a cluster left over from before the last soft clear
+    if (cluster.epoch16 != epoch)
+    {
+        for (TTEntry& e : cluster.entry)
+            e.depth8 = 0;
+        cluster.epoch16 = epoch;
+    }
+
+#ifdef USE_TT_SIMD
+    if (const u32 matches = matching_entries(tte, keyBits))
+    {
+        TTEntry* const match = &tte[lsb(matches)];
+
+        // This gap is the main place for read races.
+        // After `read()` completes that copy is final, but may be self-inconsistent.
+        return {match->is_occupied(), match->read(), TTWriter(match, coldTier.get())};
+    }
+
+    // Find an entry to be replaced according to the replacement strategy
+    TTEntry* replace = &tte[victim_entry(tte, generation8)];
+#else
     for (int i = 0; i < ClusterSize; ++i)
-        if (tte[i].key16 == key16)
+        if (tte[i].key == keyBits)
             // This gap is the main place for read races.
             // After `read()` completes that copy is final, but may be self-inconsistent.
-            return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i])};
+            return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i], coldTier.get())};
 
     // Find an entry to be replaced according to the replacement strategy
     TTEntry* replace = tte;
@@ -268,9 +1144,20 @@ std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) cons
         if (replace->depth8 - 8 * replace->relative_age(generation8)
             > tte[i].depth8 - 8 * tte[i].relative_age(generation8))
             replace = &tte[i];
+#endif
+
+    // On a miss, fall back to the cold tier. A hit is promoted back into the table,
+    // so that later probes find it there and writes keep its move.
+    if (coldTier)
+        if (auto data = coldTier->probe(key))
+        {
+            replace->save(key, data->value, data->is_pv, data->bound, data->depth, data->move,
+                          VALUE_NONE, generation8);
+            return {true, *data, TTWriter(replace, coldTier.get())};
+        }
 
     return {false, TTData{Move::none(), VALUE_NONE, VALUE_NONE, DEPTH_NONE, BOUND_NONE, false},
-            TTWriter(replace)};
+            TTWriter(replace, coldTier.get())};
 }
 
 
@@ -278,4 +1165,10 @@ TTEntry* TranspositionTable::first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
 }
 
+
+void TranspositionTable::prefetch_batch(const Key* keys, int count) const {
+    for (int i = 0; i < count; ++i)
+        prefetch(first_entry(keys[i]));
+}
+
 }  // namespace Stockfish
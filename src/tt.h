@@ -19,7 +19,15 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <array>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
 #include <tuple>
+#include <vector>
 
 #include "misc.h"
 #include "memory.h"
@@ -28,6 +36,8 @@
 namespace Stockfish {
 
 class ThreadPool;
+class NumaConfig;
+class ColdTier;
 struct TTEntry;
 struct Cluster;
 
@@ -68,27 +78,83 @@ struct TTWriter {
    public:
     void write(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, u8 generation8);
     void penalize(int penalty);  // decrement stored depth by the penalty
+    bool occupied() const;       // Whether the entry holds data, of another position after a miss
 
    private:
     friend class TranspositionTable;
-    TTEntry* entry;
-    TTWriter(TTEntry* tte);
+    TTEntry*  entry;
+    ColdTier* coldTier;  // Deep writes are also stored there, if enabled
+    TTWriter(TTEntry* tte, ColdTier* cold);
+};
+
+
+// The distribution of the entries of the table, or of a sample of its clusters
+struct TTStats {
+    usize                  clusters = 0;  // Scanned clusters
+    usize                  entries  = 0;  // Scanned entries, occupied or not
+    usize                  occupied = 0;
+    std::array<usize, 256> depth{};  // Occupied entries by depth - DEPTH_NONE
+    std::array<usize, 32>  age{};    // Occupied entries by age relative to the current search
+    std::array<usize, 4>   bound{};  // Occupied entries by Bound
+    usize                  pv = 0;   // Occupied entries of PV nodes
+};
+
+
+// How the pages of the table are spread over the NUMA nodes
+enum class TTPlacement {
+    FirstTouch,  // Left to the OS, pages land where the clearing threads run
+    Interleave,  // Pages interleaved over the nodes running search threads
+    NodeLocal    // Each node holds the part of the table its threads clear
 };
 
 
 class TranspositionTable {
 
    public:
-    ~TranspositionTable() { aligned_large_pages_free(table); }
-
-    void resize(usize mbSize, ThreadPool& threads);  // Set TT size in MiB
-    void clear(ThreadPool& threads);                 // Re-initialize memory, multithreaded
+    TranspositionTable();
+    ~TranspositionTable();
+
+    // A private table grown by more than this factor does not keep its entries
+    static constexpr usize MaxRehashGrowth = 4;
+
+    // Set TT size in MiB, placing the memory on the NUMA nodes of the threads. The
+    // entries of the previous table are rehashed into the new one. If sharedName is
+    // not empty, the table lives in named shared memory, shared with all processes of
+    // this build using the same name and size. Returns false if sharing failed, in
+    // which case the table is private.
+    bool resize(usize              mbSize,
+                ThreadPool&        threads,
+                const NumaConfig&  numaConfig,
+                TTPlacement        placement,
+                const std::string& sharedName);
+    void clear(ThreadPool& threads);  // Re-initialize memory, multithreaded
+    bool soft_clear();                // Invalidate all entries in constant time, see tt.cpp
+    bool is_shared() const { return sharedTable != nullptr; }
+    usize size_mb() const;
+
+    // Describes the cluster geometry selected at compile time, e.g. "32x3, 16-bit keys"
+    static std::string cluster_geometry();
+
+    // Set the size of the cold tier in MiB, 0 disables it. The cold tier keeps deep
+    // entries in a denser format, so that they survive eviction from the table.
+    void resize_cold_tier(usize mbSize, ThreadPool& threads);
+
+    // Sample where the pages of the table reside, as a count of sampled pages per
+    // system NUMA node. Pages not yet touched are counted under node -1.
+    std::map<int, usize> numa_placement() const;
+
+    // Write the table to a snapshot file, or map a snapshot back in as the table. A
+    // snapshot of another size is rehashed. Both return an error message on failure.
+    std::optional<std::string> save(const std::filesystem::path& file) const;
+    std::optional<std::string> load(const std::filesystem::path& file, ThreadPool& threads);
 
     void
     new_search();  // This must be called at the beginning of each root search to track entry aging
     u8 generation() const;  // The current age, used when writing new data to the TT
     // Approximate what fraction of entries (permille) have been written to during this root search
     int hashfull(int maxAge = 0) const;
+    // Scan all clusters, or about sampleClusters evenly spaced ones, in parallel
+    TTStats stats(ThreadPool& threads, usize sampleClusters = 0) const;
 
     // `probe` is the primary method: given a board position, we lookup its entry in the table, and return a tuple of:
     //   1) whether the entry already had data on this position
@@ -97,12 +163,38 @@ class TranspositionTable {
     std::tuple<bool, TTData, TTWriter> probe(const Key key) const;
     // The hash function; its only external use is memory prefetching
     TTEntry* first_entry(const Key key) const;
+    // Prefetch the clusters of several keys in one go, so that their memory latencies
+    // overlap. The results are then read with probe() as usual, which hits the cache.
+    void prefetch_batch(const Key* keys, int count) const;
 
    private:
     friend struct TTEntry;
 
-    usize    clusterCount;
-    Cluster* table = nullptr;
+    struct SharedTable;
+
+    void free_table();
+    void clear_table(ThreadPool& threads);
+    void clear_cold_tier(ThreadPool& threads);
+    bool open_shared(const std::string& name, usize ttBytes);
+    void apply_placement();
+    void rehash_from(const TranspositionTable& old, ThreadPool& threads);
+
+    usize    clusterCount = 0;
+    Cluster* table       = nullptr;
+    usize    mappedBytes = 0;  // Non-zero if the table is mapped from a snapshot file
+    u16      epoch       = 0;  // Soft clears since the last clear, tags the clusters
+
+    std::unique_ptr<SharedTable> sharedTable;  // Set if the table lives in shared memory
+    std::unique_ptr<ColdTier>    coldTier;
+
+    // A contiguous byte range of the table and the system NUMA nodes it is placed on
+    struct PlacementRange {
+        usize           begin, end;
+        std::set<usize> systemNodes;
+    };
+
+    TTPlacement                 placement = TTPlacement::FirstTouch;
+    std::vector<PlacementRange> placementRanges;
 
     u8 generation8 = 0;
 };
@@ -22,6 +22,7 @@
 #include <cctype>
 #include <cmath>
 #include <cstdlib>
+#include <iomanip>
 #include <iterator>
 #include <optional>
 #include <sstream>
@@ -130,6 +131,7 @@ void UCIEngine::loop() {
             // send info strings after the go command is sent for old GUIs and python-chess
             print_info_string(engine.numa_config_information_as_string());
             print_info_string(engine.thread_allocation_information_as_string());
+            print_info_string(engine.tt_placement_information_as_string());
             go(is);
         }
         else if (token == "position")
@@ -151,10 +153,58 @@ void UCIEngine::loop() {
             bench(is);
         else if (token == BenchmarkCommand)
             benchmark(is);
+        else if (token == "scaling")
+            scaling(is);
         else if (token == "d")
             sync_cout << engine.visualize() << sync_endl;
         else if (token == "eval")
             engine.trace_eval();
+        else if (token == "evalbatch")
+        {
+            std::string filename;
+            std::getline(is >> std::ws, filename);
+
+            if (filename.empty())
+                print_info_string("Usage: evalbatch <file>");
+            else if (const auto err = engine.eval_batch(path_from_utf8(filename)))
+                print_info_string(*err);
+        }
+        else if (token == "nnuebench")
+        {
+            int rounds = 100;
+            is >> rounds;
+
+            // Run before taking the output lock, network verification prints
+            const std::string report = engine.nnue_bench(std::max(rounds, 1));
+            sync_cout << report << sync_endl;
+        }
+        else if (token == "reorder_net")
+        {
+            std::string filename, fenFile;
+            is >> filename >> std::ws;
+            std::getline(is, fenFile);
+
+            if (filename.empty())
+                print_info_string("Usage: reorder_net <file> [fen file]");
+            else if (const auto err = engine.reorder_network(
+                       path_from_utf8(filename),
+                       fenFile.empty() ? std::nullopt
+                                       : std::make_optional(path_from_utf8(fenFile))))
+                print_info_string(*err);
+        }
+        else if (token == "publish_net")
+        {
+            // Unlike setoption, this does not wait for the search to finish
+            std::string filename;
+            std::getline(is >> std::ws, filename);
+
+            if (filename.empty())
+                print_info_string("Usage: publish_net <file>");
+            else if (const auto err = engine.publish_network(filename))
+                print_info_string(*err);
+            else
+                print_info_string("Published network " + filename);
+        }
         else if (token == "compiler")
             sync_cout << compiler_info() << sync_endl;
         else if (token == "export_net")
@@ -162,10 +212,48 @@ void UCIEngine::loop() {
             std::optional<std::filesystem::path> file;
             std::string                          filename;
 
-            if (is >> filename)
+            // "export_net native <file>" writes the build specific in-memory image
+            const bool native = is >> filename && filename == "native";
+            if (native)
+            {
+                filename.clear();
+                is >> filename;
+            }
+
+            if (!filename.empty())
                 file = path_from_utf8(filename);
 
-            engine.save_network(file);
+            if (native && !file)
+                print_info_string("Usage: export_net native <file>");
+            else
+                engine.save_network(file, native);
+        }
+        else if (token == "tt")
+        {
+            std::string action, filename;
+            is >> action >> std::ws;
+            std::getline(is, filename);
+
+            if ((action != "save" && action != "load") || filename.empty())
+                print_info_string("Usage: tt save|load <file>");
+            else
+            {
+                const auto file = path_from_utf8(filename);
+                const auto err  = action == "save" ? engine.save_tt(file) : engine.load_tt(file);
+
+                if (err)
+                    print_info_string(*err);
+                else if (action == "save")
+                    print_info_string("Transposition table saved to " + filename);
+                else
+                    print_info_string("Transposition table loaded from " + filename);
+            }
+        }
+        else if (token == "ttstats")
+        {
+            usize sampleClusters = 0;
+            is >> sampleClusters;
+            sync_cout << engine.tt_stats(sampleClusters) << sync_endl;
         }
         else if (token == "--help" || token == "help" || token == "--license" || token == "license")
             sync_cout
@@ -389,6 +477,8 @@ void UCIEngine::benchmark(std::istream& args) {
         }
     };
 
+    u64 ttProbes = 0, ttHits = 0, evalCacheProbes = 0, evalCacheHits = 0;
+
     engine.search_clear();  // search_clear may take a while
 
     for (const auto& cmd : setup.commands)
@@ -414,6 +504,10 @@ void UCIEngine::benchmark(std::istream& args) {
 
             updateHashfullReadings();
 
+            ttProbes += engine.get_tt_probes();
+            ttHits += engine.get_tt_hits();
+            evalCacheProbes += engine.get_eval_cache_probes();
+            evalCacheHits += engine.get_eval_cache_hits();
             nodes += nodesSearched;
         }
         else if (token == "position")
@@ -453,6 +547,11 @@ void UCIEngine::benchmark(std::istream& args) {
               << "\nThread count               : " << setup.threads
               << "\nThread binding             : " << threadBinding
               << "\nTT size [MiB]              : " << setup.ttSize
+              << "\nTT cluster geometry        : " << engine.tt_geometry_information_as_string()
+              << "\nTT hit rate [per mille]    : "
+              << (ttProbes ? std::to_string(1000 * ttHits / ttProbes) : "n/a")
+              << "\nEval hit rate [per mille]  : "
+              << (evalCacheProbes ? std::to_string(1000 * evalCacheHits / evalCacheProbes) : "n/a")
               << "\nHash max, avg [per mille]  : "
               << "\n    single search          : " << maxHashfull[0] << ", "
               << totalHashfull[0] / numHashfullReadings
@@ -467,6 +566,94 @@ void UCIEngine::benchmark(std::istream& args) {
     init_search_update_listeners();
 }
 
+// Reports the time to depth of the bench positions with 1, 2, 4... threads,
+// without and with the cooperative search. Lazy SMP is not deterministic, so
+// the times of a single run vary, compare runs to depths of a few seconds.
+void UCIEngine::scaling(std::istream& args) {
+    int maxThreads, depth, ttSize;
+
+    // Assign default values to missing arguments
+    if (!(args >> maxThreads))
+        maxThreads = int(get_hardware_concurrency());
+    if (!(args >> depth))
+        depth = 13;
+    if (!(args >> ttSize))
+        ttSize = 256;
+
+    std::string token;
+    const bool  cooperative = engine.get_options()["CooperativeSearch"];
+
+    engine.set_on_update_full([](const auto&) {});
+    engine.set_on_iter([](const auto&) {});
+    engine.set_on_update_no_moves([](const auto&) {});
+    engine.set_on_bestmove([](const auto&, const auto&) {});
+    engine.set_on_verify_network([](const auto&) {});
+
+    auto setCooperative = [&](bool value) {
+        auto ss = std::istringstream(std::string("name CooperativeSearch value ")
+                                     + (value ? "true" : "false"));
+        setoption(ss);
+    };
+
+    // Returns the search time of the bench positions, starting from a cleared TT
+    auto run = [&](int threads) {
+        std::istringstream setup(std::to_string(ttSize) + " " + std::to_string(threads) + " "
+                                 + std::to_string(depth));
+        TimePoint elapsed = 0;
+
+        for (const auto& cmd : Benchmark::setup_bench(engine.fen(), setup))
+        {
+            std::istringstream is(cmd);
+            is >> token;
+
+            if (token == "go")
+            {
+                Search::LimitsType limits = parse_limits(is);
+
+                TimePoint start = now();
+                engine.go(limits);
+                engine.wait_for_search_finished();
+                elapsed += now() - start;
+            }
+            else if (token == "setoption")
+                setoption(is);
+            else if (token == "position")
+                position(is);
+            else if (token == "ucinewgame")
+                engine.search_clear();  // search_clear may take a while
+        }
+
+        return std::max<TimePoint>(elapsed, 1);  // Ensure positivity to avoid a 'divide by zero'
+    };
+
+    std::cerr << "\nThreads  Lazy SMP [ms]  Speedup  Cooperative [ms]  Speedup" << std::endl;
+
+    TimePoint base = 0;
+
+    for (int threads = 1;; threads = std::min(2 * threads, maxThreads))
+    {
+        setCooperative(false);
+        const TimePoint lazy = run(threads);
+
+        // With one thread the cooperative search is disabled
+        setCooperative(true);
+        const TimePoint coop = threads > 1 ? run(threads) : lazy;
+
+        if (threads == 1)
+            base = lazy;
+
+        std::cerr << std::setw(7) << threads << std::setw(15) << lazy << std::setw(9)
+                  << std::fixed << std::setprecision(2) << double(base) / lazy << std::setw(18)
+                  << coop << std::setw(9) << double(base) / coop << std::endl;
+
+        if (threads >= maxThreads)
+            break;
+    }
+
+    setCooperative(cooperative);
+    init_search_update_listeners();
+}
+
 void UCIEngine::setoption(std::istringstream& is) {
     engine.wait_for_search_finished();
     engine.get_options().setoption(is);
@@ -173,6 +173,11 @@ class TestCLI(metaclass=OrderedClassMembers):
     # verify the generated net equals the base net
 
     def test_network_equals_base(self):
+        # a build with 4-bit threat weights exports its own format
+        compiler = Stockfish(["compiler"], True).process.stdout
+        if "INT4_THREATS" in compiler:
+            return
+
         self.stockfish = Stockfish(
             ["uci"],
             True,
@@ -291,6 +296,143 @@ class TestInteractive(metaclass=OrderedClassMembers):
     def test_clear_hash(self):
         self.stockfish.send_command("setoption name Clear Hash")
 
+    def test_hash_numa_policy(self):
+        for policy in ["interleave", "local", "none", "auto"]:
+            self.stockfish.send_command(f"setoption name HashNumaPolicy value {policy}")
+            self.stockfish.send_command("position startpos")
+            self.stockfish.send_command("go depth 5")
+            self.stockfish.starts_with("bestmove")
+
+    def test_resize_hash_keeps_entries(self):
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 10")
+        self.stockfish.starts_with("bestmove")
+
+        for size in [8, 32, 16]:
+            self.stockfish.send_command(f"setoption name Hash value {size}")
+            self.stockfish.send_command("go depth 10")
+            self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("setoption name Hash value 128")
+        self.stockfish.expect("info string Hash grown more than 4 times*")
+        self.stockfish.send_command("setoption name Hash value 16")
+
+    def test_shared_hash(self):
+        self.stockfish.send_command("setoption name SharedHash value instrumented")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("setoption name SharedHash value <empty>")
+
+    def test_soft_clear(self):
+        self.stockfish.send_command("setoption name SoftClear value true")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        # entries of the previous game read as empty
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("ttstats")
+        self.stockfish.expect("Scanned * clusters, 0 of * entries occupied *")
+
+        self.stockfish.send_command("position startpos moves e2e4")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("setoption name SoftClear value false")
+
+    def test_cold_hash(self):
+        self.stockfish.send_command("setoption name ColdHash value 4")
+        self.stockfish.send_command("setoption name Hash value 1")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 12")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("setoption name ColdHash value 0")
+        self.stockfish.send_command("setoption name Hash value 16")
+
+    def test_tt_save_and_load(self):
+        snapshot = os.path.join(os.path.abspath(os.getcwd()), "tt.snap")
+
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command(f"tt save {snapshot}")
+        self.stockfish.expect(f"info string Transposition table saved to {snapshot}")
+        self.stockfish.send_command(f"tt load {snapshot}")
+        self.stockfish.expect(f"info string Transposition table loaded from {snapshot}")
+
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+    def test_ttstats(self):
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("ttstats 1000")
+        self.stockfish.starts_with("Sampled 1000 clusters")
+        self.stockfish.send_command("ttstats")
+        self.stockfish.starts_with("Scanned")
+        self.stockfish.starts_with("Accumulator updates in the last search")
+        self.stockfish.starts_with("incremental")
+
+    def test_eval_cache(self):
+        for size in [4, 1, 0]:
+            self.stockfish.send_command(f"setoption name EvalCache value {size}")
+            self.stockfish.expect(f"info string Eval cache: {size} MiB per thread")
+            self.stockfish.send_command("position startpos")
+            self.stockfish.send_command("go depth 8")
+            self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("ttstats 1000")
+        self.stockfish.starts_with("eval hits")
+
+    def test_accumulator_store(self):
+        for size in [8, 0]:
+            self.stockfish.send_command(f"setoption name AccumulatorStore value {size}")
+            self.stockfish.expect(f"info string Accumulator store: {size} MiB per thread")
+            self.stockfish.send_command("position startpos moves e2e4 e7e5")
+            self.stockfish.send_command("go depth 8")
+            self.stockfish.starts_with("bestmove")
+            self.stockfish.send_command("ttstats 1000")
+            self.stockfish.starts_with("store")
+
+    def test_cooperative_search(self):
+        self.stockfish.send_command("setoption name Threads value 4")
+        self.stockfish.send_command("setoption name CooperativeSearch value true")
+        self.stockfish.send_command("position startpos moves e2e4 e7e5")
+        self.stockfish.send_command("go depth 12")
+        self.stockfish.starts_with("bestmove")
+        self.stockfish.send_command("setoption name CooperativeSearch value false")
+        self.stockfish.send_command("setoption name Threads value 1")
+
+    def test_evalbatch(self):
+        self.stockfish.send_command(f"evalbatch {os.path.join(PATH, 'bench_tmp.epd')}")
+        self.stockfish.expect(
+            "r4rk1/1b2ppbp/pq4pn/2pp1PB1/1p2P3/1P1P1NN1/1PP3PP/R2Q1RK1 w - - 0 13 ; *"
+        )
+        self.stockfish.starts_with("info string Evaluated 4 positions (0 skipped)")
+
+    def test_nnuebench(self):
+        self.stockfish.send_command("nnuebench 1")
+        self.stockfish.starts_with("NNUE stage benchmark on")
+        self.stockfish.starts_with("Checksum:")
+
+    def test_reorder_net(self):
+        self.stockfish.send_command(
+            f"reorder_net reordered.nnue {os.path.join(PATH, 'bench_tmp.epd')}"
+        )
+        self.stockfish.starts_with("info string Sampled 4 positions (0 skipped)")
+        self.stockfish.starts_with("info string Non-zero fc_0 input chunks per position:")
+        self.stockfish.equals("Network saved successfully to reordered.nnue")
+
     def test_fen_position_mate_1(self):
         self.stockfish.send_command("ucinewgame")
         self.stockfish.send_command(
@@ -397,12 +539,68 @@ class TestInteractive(metaclass=OrderedClassMembers):
         self.stockfish.send_command("go depth 5")
         self.stockfish.starts_with("bestmove")
 
+    def test_export_net_round_trip(self):
+        current_path = os.path.abspath(os.getcwd())
+
+        self.stockfish.send_command("setoption name EvalFile value verify.nnue")
+        self.stockfish.send_command(
+            f"export_net {os.path.join(current_path, 'round_trip.nnue')}"
+        )
+        self.stockfish.expect("Network saved successfully to *round_trip.nnue")
+        self.stockfish.send_command("eval")
+        self.stockfish.expect("Final evaluation *")
+
+        diff = subprocess.run(["diff", "verify.nnue", "round_trip.nnue"])
+        assert diff.returncode == 0
+
+    def test_verify_native_network(self):
+        current_path = os.path.abspath(os.getcwd())
+        Stockfish(
+            f"export_net native {os.path.join(current_path, 'verify.native')}".split(" "),
+            True,
+        )
+
+        self.stockfish.send_command("setoption name EvalFile value verify.native")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 5")
+        self.stockfish.starts_with("bestmove")
+
+    def test_publish_net(self):
+        current_path = os.path.abspath(os.getcwd())
+        Stockfish(
+            f"export_net {os.path.join(current_path, 'verify.nnue')}".split(" "), True
+        )
+
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go infinite")
+        self.stockfish.send_command("publish_net missing.nnue")
+        self.stockfish.expect("info string Failed to load the network missing.nnue")
+        self.stockfish.send_command("publish_net verify.nnue")
+        self.stockfish.expect("info string Published network verify.nnue")
+        self.stockfish.send_command("stop")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("go depth 5")
+        self.stockfish.starts_with("bestmove")
+
     def test_multipv_setting(self):
         self.stockfish.send_command("setoption name MultiPV value 4")
         self.stockfish.send_command("position startpos")
         self.stockfish.send_command("go depth 5")
         self.stockfish.starts_with("bestmove")
 
+    def test_parallel_multipv(self):
+        self.stockfish.send_command("setoption name Threads value 4")
+        self.stockfish.send_command("setoption name MultiPV value 4")
+        self.stockfish.send_command("setoption name ParallelMultiPV value true")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 10")
+        self.stockfish.contains("depth 10 seldepth")
+        self.stockfish.contains("multipv 4")
+        self.stockfish.starts_with("bestmove")
+        self.stockfish.send_command("setoption name ParallelMultiPV value false")
+        self.stockfish.send_command("setoption name Threads value 1")
+
     def test_fen_position_with_skill_level(self):
         self.stockfish.send_command("setoption name Skill Level value 10")
         self.stockfish.send_command("position startpos")